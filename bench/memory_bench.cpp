@@ -0,0 +1,179 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// 6502-bench: many machines with heap pages versus a MemoryPool.
+//
+//   6502-bench [machines] [accesses]
+//
+// Every machine gets a small program and some scattered data, as a farm of
+// test jobs would. One pass then reads random bytes of random machines.
+// For each allocator it reports resident memory, transparent huge pages,
+// time per access and, where perf events are allowed, dTLB read misses.
+
+namespace
+{
+    std::size_t resident_kb(const char *field)
+    {
+        std::ifstream status("/proc/self/smaps_rollup");
+        std::string line;
+        std::size_t length = std::strlen(field);
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, length, field) == 0)
+            {
+                return std::strtoull(line.c_str() + length, nullptr, 10);
+            }
+        }
+        return 0;
+    }
+
+    // dTLB read misses of this thread; -1 when perf events are not available
+    struct tlb_counter
+    {
+        int fd = -1;
+
+        tlb_counter()
+        {
+#if defined(__linux__)
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fd >= 0)
+            {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        ~tlb_counter()
+        {
+#if defined(__linux__)
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+#endif
+        }
+
+        long long read_misses()
+        {
+            long long count = -1;
+#if defined(__linux__)
+            if (fd < 0 || ::read(fd, &count, sizeof(count)) != sizeof(count))
+            {
+                return -1;
+            }
+#endif
+            return count;
+        }
+    };
+
+    void run(const char *name, MemoryPool *pool, std::size_t machines, std::size_t accesses)
+    {
+        std::size_t rss_before = resident_kb("Rss:");
+        std::size_t huge_before = resident_kb("AnonHugePages:");
+
+        std::vector<std::unique_ptr<Memory>> farm;
+        std::mt19937 rng(1);
+        for (std::size_t i = 0; i < machines; i++)
+        {
+            farm.push_back(pool != nullptr ? std::make_unique<Memory>(pool) : std::make_unique<Memory>());
+            for (Word address = 0x0200; address < 0x0240; address++)
+            {
+                farm.back()->write(address, rng());
+            }
+            for (int j = 0; j < 16; j++)
+            {
+                farm.back()->write(rng(), rng());
+            }
+        }
+
+        std::size_t rss = resident_kb("Rss:") - rss_before;
+        std::size_t huge = resident_kb("AnonHugePages:") - huge_before;
+
+        unsigned sum = 0;
+        tlb_counter tlb;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < accesses; i++)
+        {
+            std::uint32_t r = rng();
+            sum += farm[r % machines]->read(rng());
+        }
+        auto end = std::chrono::steady_clock::now();
+        long long misses = tlb.read_misses();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / accesses;
+
+        std::printf("%-10s rss %8zu KB  thp %8zu KB  %6.2f ns/access  ", name, rss, huge, ns);
+        if (misses >= 0)
+        {
+            std::printf("dTLB misses %6.3f/access", double(misses) / accesses);
+        }
+        else
+        {
+            std::printf("dTLB misses n/a");
+        }
+        std::printf("  (checksum %u)\n", sum & 0xFF);
+
+        if (pool != nullptr)
+        {
+            // a second generation of machines reuses the released pages
+            std::size_t arenas = pool->getStats().arenas;
+            farm.clear();
+            for (std::size_t i = 0; i < machines; i++)
+            {
+                farm.push_back(std::make_unique<Memory>(pool));
+            }
+            pool_stats stats = pool->getStats();
+            std::printf("%-10s %zu arenas, %zu after recycling, %zu pages in use, huge pages: %s\n", "", arenas,
+                        stats.arenas, stats.pages_used, stats.huge_pages ? "yes" : "no");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t machines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    std::size_t accesses = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000000;
+    if (machines == 0 || accesses == 0)
+    {
+        std::fprintf(stderr, "usage: %s [machines] [accesses]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%zu machines, %zu random reads\n", machines, accesses);
+    run("heap", nullptr, machines, accesses);
+    {
+        MemoryPool pool(false);
+        run("pool", &pool, machines, accesses);
+    }
+    {
+        MemoryPool pool(true);
+        run("pool+thp", &pool, machines, accesses);
+    }
+    return 0;
+}
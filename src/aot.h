@@ -0,0 +1,90 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include "cpu.h"
+#include "cpu_ops.h"
+
+// Runtime for programs emitted by Recompiler. Generated code is a single
+// function with one label per traced instruction; each label calls
+// step<opcode>() with the operand and next PC baked in, so the (op, mode)
+// policies inline into straight-line code and no dispatch is left. Each
+// label first checks that memory still holds the bytes it was traced from,
+// and returns false if not, so a store over the code or another image
+// loaded under the installed function is interpreted instead.
+
+struct CPU::aot
+{
+    struct opcode_info
+    {
+        const char *mnemonic;
+        Byte length; // opcode + operand bytes
+        bool relative;
+        bool implemented;
+    };
+
+    static const opcode_info &describe(Byte opcode)
+    {
+        static constexpr std::array<opcode_info, 256> table = [] {
+            std::array<opcode_info, 256> t{};
+            for (auto &slot : t)
+            {
+                slot = {"???", 1, false, false};
+            }
+#define CPU_AOT_INFO(code, mnemonic, addressing, cycles) \
+    t[code] = {#mnemonic, 1 + mode::addressing::length,   \
+               std::is_same<mode::addressing, mode::relative>::value, true};
+            CPU_OPCODES(CPU_AOT_INFO)
+#undef CPU_AOT_INFO
+            return t;
+        }();
+        return table[opcode];
+    }
+
+    template <Byte Opcode>
+    struct instruction; // (op, mode, cycles) of each implemented opcode, below
+
+    // true when the caller must return before the next instruction
+    static bool stop(const CPU &cpu, std::uint64_t cycle_limit, std::int32_t stop_at)
+    {
+        return cpu.interrupt || cpu.clock_cycles >= cycle_limit || cpu.PC == stop_at;
+    }
+
+    static Word pc(const CPU &cpu) { return cpu.PC; }
+
+    // memory at pc still holds Opcode and its operand, as traced
+    template <Byte Opcode>
+    static bool traced(CPU &cpu, Word pc, Word operand)
+    {
+        constexpr int length = instruction<Opcode>::addressing::length;
+        Memory &memory = *cpu.memory;
+        return memory.read(pc) == Opcode && (length < 1 || memory.read(pc + 1) == (operand & 0xFF)) &&
+               (length < 2 || memory.read(pc + 2) == (operand >> 8));
+    }
+
+    // same steps as the cached engine, with everything known at compile time
+    template <Byte Opcode>
+    static void step(CPU &cpu, Word operand, Word next)
+    {
+        using I = instruction<Opcode>;
+        cpu.opcode = Opcode;
+        cpu.PC = next;
+        CPU::decoded<typename I::operation, typename I::addressing>(cpu, operand);
+        cpu.clock_cycles += I::cycles;
+    }
+};
+
+#define CPU_AOT_INSTRUCTION(code, mnemonic, mode_name, base_cycles) \
+    template <>                                                     \
+    struct CPU::aot::instruction<code>                              \
+    {                                                               \
+        using operation = CPU::op::mnemonic;                        \
+        using addressing = CPU::mode::mode_name;                    \
+        static constexpr Byte cycles = base_cycles;                 \
+    };
+CPU_OPCODES(CPU_AOT_INSTRUCTION)
+#undef CPU_AOT_INSTRUCTION
+
+#endif // AOT_H
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <string>
+
+#include "loader.h"
+#include "memory.h"
+#include "recompiler.h"
+
+// 6502-aot: recompile a raw binary image into C++.
+//
+//   6502-aot <image> <load-address> <function> <entry> [<entry> ...]
+//
+// Addresses are hex. The source goes to stdout; compile it with -I src and
+// hand the function to CPU::setRecompiled() after loading the same image.
+
+int main(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "usage: " << argv[0] << " <image> <load-address> <function> <entry>...\n";
+        return 2;
+    }
+
+    unsigned long load = std::stoul(argv[2], nullptr, 16);
+    Image file;
+    if (load > 0xFFFF || !file.open(argv[1], Image::RAW, static_cast<Word>(load)))
+    {
+        std::cerr << argv[0] << ": cannot load " << argv[1] << " at $" << argv[2] << "\n";
+        return 1;
+    }
+
+    Memory image;
+    file.load(image);
+
+    Recompiler recompiler(image);
+    for (int i = 4; i < argc; i++)
+    {
+        recompiler.trace(static_cast<Word>(std::stoul(argv[i], nullptr, 16)));
+    }
+
+    std::cout << recompiler.emit(argv[3]);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "block_cache.h"
+
+#include <algorithm>
+
+BlockCache::BlockCache(Memory *memory)
+{
+    this->memory = memory;
+    epoch = 0;
+    stats = {0, 0, 0};
+    memory->set_watcher(this);
+}
+
+BlockCache::~BlockCache()
+{
+    memory->set_watcher(nullptr);
+}
+
+const Block *BlockCache::find(Word pc)
+{
+    retired.clear();
+
+    auto it = blocks.find(pc);
+    if (it == blocks.end())
+    {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    return &it->second;
+}
+
+const Block &BlockCache::insert(Block block)
+{
+    Word start = block.start;
+
+    // a block spans at most a couple of pages; record it under each
+    Byte first = block.start >> 8;
+    Byte last = (Word)(block.ops.back().next - 1) >> 8;
+    for (Byte page = first;; page++)
+    {
+        auto &starts = page_blocks[page];
+        if (std::find(starts.begin(), starts.end(), start) == starts.end())
+        {
+            starts.push_back(start);
+        }
+        memory->watch_page(page);
+        if (page == last)
+        {
+            break;
+        }
+    }
+
+    return blocks.insert_or_assign(start, std::move(block)).first->second;
+}
+
+void BlockCache::clear()
+{
+    blocks.clear();
+    retired.clear();
+    for (auto &starts : page_blocks)
+    {
+        starts.clear();
+    }
+    memory->set_watcher(this);
+    epoch++;
+}
+
+void BlockCache::page_written(Byte page)
+{
+    for (Word start : page_blocks[page])
+    {
+        // a start may be listed under several pages and already be gone
+        auto node = blocks.extract(start);
+        if (!node.empty())
+        {
+            retired.push_back(std::move(node));
+            stats.invalidations++;
+        }
+    }
+    page_blocks[page].clear();
+    epoch++;
+}
@@ -0,0 +1,100 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "memory.h"
+#include "types.h"
+
+class CPU;
+
+// One predecoded instruction: the resolved (op, mode) handler, its operand
+// bytes, the address of the following instruction and its base cycles.
+struct DecodedOp
+{
+    void (*handler)(CPU &cpu, Word operand);
+    Word operand;
+    Word next;
+    Byte cycles;
+    Byte opcode;
+    Byte fused; // 1 + CPU::fusions() index of a superinstruction starting here; 0 for none
+    void (*lean)(CPU &cpu, Word operand); // handler leaving out flags nothing reads; handler if none
+};
+
+// A straight-line run of instructions ending at a branch, BRK/ILL or the
+// length limit.
+struct Block
+{
+    std::vector<DecodedOp> ops;
+    Word start;
+    std::uint32_t head_cycles; // worst case before the last instruction starts
+    bool lean;                 // some op has a lean handler
+    bool spins;                // branches back to start, storing nothing and following no pointer
+    std::vector<Byte> pages;   // pages a spinning block reads
+};
+
+struct cache_stats
+{
+    std::uint64_t hits;          // block found already decoded
+    std::uint64_t misses;        // block had to be decoded
+    std::uint64_t invalidations; // blocks dropped because their code page was written
+};
+
+struct fusion_stats
+{
+    std::uint64_t formed;   // superinstructions built while decoding blocks
+    std::uint64_t executed; // superinstructions run as one dispatch
+    std::uint64_t split;    // run an instruction at a time: the budget or a stop address fell inside
+    std::vector<std::uint64_t> by_sequence; // executed, per CPU::fusions() entry
+};
+
+struct elision_stats
+{
+    std::uint64_t nz;    // instructions decoded with N/Z left out
+    std::uint64_t cv;    // instructions decoded with C/V left out
+    std::uint64_t lean;  // block runs with the lean handlers
+    std::uint64_t exact; // block runs that could stop partway, so computed every flag
+};
+
+struct idle_stats
+{
+    std::uint64_t loops;   // spin loops fast-forwarded
+    std::uint64_t skipped; // cycles they were moved on by, without running
+};
+
+// Predecoded blocks keyed by start PC. Every page a block was decoded from
+// is watched in Memory; the first write to such a page drops all blocks on
+// it, so self-modifying code is re-decoded on its next execution.
+class BlockCache : public PageWatcher
+{
+private:
+    Memory *memory;
+    std::unordered_map<Word, Block> blocks;
+    std::vector<Word> page_blocks[256]; // start PCs of blocks touching each page
+
+    // Dropped blocks are parked here until the next lookup, since the
+    // block being executed may be the one a store just invalidated.
+    std::vector<std::unordered_map<Word, Block>::node_type> retired;
+
+    std::uint64_t epoch; // bumped on every invalidation
+    cache_stats stats;
+
+public:
+    static const std::size_t MAX_BLOCK_OPS = 32;
+
+    BlockCache(Memory *memory);
+    ~BlockCache();
+
+    const Block *find(Word pc); // counts a hit or a miss
+    const Block &insert(Block block);
+    void clear();
+
+    void page_written(Byte page) override;
+
+    std::uint64_t generation() const { return epoch; }
+    const cache_stats &getStats() const { return stats; }
+};
+
+#endif // BLOCK_CACHE_H
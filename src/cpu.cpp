@@ -1,60 +1,328 @@
 #include "cpu.h"
+#include "cpu_ops.h"
+
+#include <cstdint>
+
+//* Opcode Lookup *//
+
+constexpr std::array<CPU::Instruction, 256> CPU::build_lookup()
+{
+    std::array<Instruction, 256> table{};
+    for (auto &slot : table)
+    {
+        slot = {&CPU::ILL, &CPU::implied, 0};
+    }
+
+    table[0x00] = {&CPU::BRK, &CPU::implied, 7};
+    //* LDA OPCODES *//
+    table[0xA9] = {&CPU::LDA, &CPU::immediate, 2};
+    table[0xA5] = {&CPU::LDA, &CPU::zeropage, 3};
+    table[0xB5] = {&CPU::LDA, &CPU::zeropageX, 4};
+    table[0xAD] = {&CPU::LDA, &CPU::absolute, 4};
+    table[0xBD] = {&CPU::LDA, &CPU::absoluteX, 4};
+    table[0xB9] = {&CPU::LDA, &CPU::absoluteY, 4};
+    table[0xA1] = {&CPU::LDA, &CPU::indirectX, 6};
+    table[0xB1] = {&CPU::LDA, &CPU::indirectY, 5};
+    //* LDX OPCODES *//
+    table[0xA2] = {&CPU::LDX, &CPU::immediate, 2};
+    table[0xA6] = {&CPU::LDX, &CPU::zeropage, 3};
+    table[0xB6] = {&CPU::LDX, &CPU::zeropageY, 4};
+    table[0xAE] = {&CPU::LDX, &CPU::absolute, 4};
+    table[0xBE] = {&CPU::LDX, &CPU::absoluteY, 4};
+    //* LDY OPCODES *//
+    table[0xA0] = {&CPU::LDY, &CPU::immediate, 2};
+    table[0xA4] = {&CPU::LDY, &CPU::zeropage, 3};
+    table[0xB4] = {&CPU::LDY, &CPU::zeropageX, 4};
+    table[0xAC] = {&CPU::LDY, &CPU::absolute, 4};
+    table[0xBC] = {&CPU::LDY, &CPU::absoluteX, 4};
+    //* STA OPCODES *//
+    table[0x85] = {&CPU::STA, &CPU::zeropage, 3};
+    table[0x95] = {&CPU::STA, &CPU::zeropageX, 4};
+    table[0x8D] = {&CPU::STA, &CPU::absolute, 4};
+    table[0x9D] = {&CPU::STA, &CPU::absoluteX, 5, false};
+    table[0x99] = {&CPU::STA, &CPU::absoluteY, 5, false};
+    table[0x81] = {&CPU::STA, &CPU::indirectX, 6};
+    table[0x91] = {&CPU::STA, &CPU::indirectY, 6, false};
+    //* STX OPCODES *//
+    table[0x86] = {&CPU::STX, &CPU::zeropage, 3};
+    table[0x96] = {&CPU::STX, &CPU::zeropageY, 4};
+    table[0x8E] = {&CPU::STX, &CPU::absolute, 4};
+    //* STY OPCODES *//
+    table[0x84] = {&CPU::STY, &CPU::zeropage, 3};
+    table[0x94] = {&CPU::STY, &CPU::zeropageX, 4};
+    table[0x8C] = {&CPU::STY, &CPU::absolute, 4};
+    //* T__ OPCODES *//
+    table[0xAA] = {&CPU::TAX, &CPU::implied, 2};
+    table[0xA8] = {&CPU::TAY, &CPU::implied, 2};
+    table[0xBA] = {&CPU::TSX, &CPU::implied, 2};
+    table[0x8A] = {&CPU::TXA, &CPU::implied, 2};
+    table[0x9A] = {&CPU::TXS, &CPU::implied, 2};
+    table[0x98] = {&CPU::TYA, &CPU::implied, 2};
+    //* Stack OPCODES *//
+    table[0x48] = {&CPU::PHA, &CPU::implied, 3};
+    table[0x08] = {&CPU::PHP, &CPU::implied, 3};
+    table[0x68] = {&CPU::PLA, &CPU::implied, 4};
+    table[0x28] = {&CPU::PLP, &CPU::implied, 4};
+    //* Decrements & Increments *//
+    table[0xC6] = {&CPU::DEC, &CPU::zeropage, 5};
+    table[0xD6] = {&CPU::DEC, &CPU::zeropageX, 6};
+    table[0xCE] = {&CPU::DEC, &CPU::absolute, 6};
+    table[0xDE] = {&CPU::DEC, &CPU::absoluteX, 7, false};
+    table[0xCA] = {&CPU::DEX, &CPU::implied, 2};
+    table[0x88] = {&CPU::DEY, &CPU::implied, 2};
+    table[0xE6] = {&CPU::INC, &CPU::zeropage, 5};
+    table[0xF6] = {&CPU::INC, &CPU::zeropageX, 6};
+    table[0xEE] = {&CPU::INC, &CPU::absolute, 6};
+    table[0xFE] = {&CPU::INC, &CPU::absoluteX, 7, false};
+    table[0xE8] = {&CPU::INX, &CPU::implied, 2};
+    table[0xC8] = {&CPU::INY, &CPU::implied, 2};
+    //* Arithmetic Operations *//
+    table[0x69] = {&CPU::ADC, &CPU::immediate, 2};
+    table[0x65] = {&CPU::ADC, &CPU::zeropage, 3};
+    table[0x75] = {&CPU::ADC, &CPU::zeropageX, 4};
+    table[0x6D] = {&CPU::ADC, &CPU::absolute, 4};
+    table[0x7D] = {&CPU::ADC, &CPU::absoluteX, 4};
+    table[0x79] = {&CPU::ADC, &CPU::absoluteY, 4};
+    table[0x61] = {&CPU::ADC, &CPU::indirectX, 6};
+    table[0x71] = {&CPU::ADC, &CPU::indirectY, 5};
+    table[0xE9] = {&CPU::SBC, &CPU::immediate, 2};
+    table[0xE5] = {&CPU::SBC, &CPU::zeropage, 3};
+    table[0xF5] = {&CPU::SBC, &CPU::zeropageX, 4};
+    table[0xED] = {&CPU::SBC, &CPU::absolute, 4};
+    table[0xFD] = {&CPU::SBC, &CPU::absoluteX, 4};
+    table[0xF9] = {&CPU::SBC, &CPU::absoluteY, 4};
+    table[0xE1] = {&CPU::SBC, &CPU::indirectX, 6};
+    table[0xF1] = {&CPU::SBC, &CPU::indirectY, 5};
+    //* Logical Operations *//
+    table[0x29] = {&CPU::AND, &CPU::immediate, 2};
+    table[0x25] = {&CPU::AND, &CPU::zeropage, 3};
+    table[0x35] = {&CPU::AND, &CPU::zeropageX, 4};
+    table[0x2D] = {&CPU::AND, &CPU::absolute, 4};
+    table[0x3D] = {&CPU::AND, &CPU::absoluteX, 4};
+    table[0x39] = {&CPU::AND, &CPU::absoluteY, 4};
+    table[0x21] = {&CPU::AND, &CPU::indirectX, 6};
+    table[0x31] = {&CPU::AND, &CPU::indirectY, 5};
+    table[0x49] = {&CPU::EOR, &CPU::immediate, 2};
+    table[0x45] = {&CPU::EOR, &CPU::zeropage, 3};
+    table[0x55] = {&CPU::EOR, &CPU::zeropageX, 4};
+    table[0x4D] = {&CPU::EOR, &CPU::absolute, 4};
+    table[0x5D] = {&CPU::EOR, &CPU::absoluteX, 4};
+    table[0x59] = {&CPU::EOR, &CPU::absoluteY, 4};
+    table[0x41] = {&CPU::EOR, &CPU::indirectX, 6};
+    table[0x51] = {&CPU::EOR, &CPU::indirectY, 5};
+    table[0x09] = {&CPU::ORA, &CPU::immediate, 2};
+    table[0x05] = {&CPU::ORA, &CPU::zeropage, 3};
+    table[0x15] = {&CPU::ORA, &CPU::zeropageX, 4};
+    table[0x0D] = {&CPU::ORA, &CPU::absolute, 4};
+    table[0x1D] = {&CPU::ORA, &CPU::absoluteX, 4};
+    table[0x19] = {&CPU::ORA, &CPU::absoluteY, 4};
+    table[0x01] = {&CPU::ORA, &CPU::indirectX, 6};
+    table[0x11] = {&CPU::ORA, &CPU::indirectY, 5};
+    //* Shift & Rotate *//
+    table[0x0A] = {&CPU::ASL, &CPU::accumulator, 2};
+    table[0x06] = {&CPU::ASL, &CPU::zeropage, 5};
+    table[0x16] = {&CPU::ASL, &CPU::zeropageX, 6};
+    table[0x0E] = {&CPU::ASL, &CPU::absolute, 6};
+    table[0x1E] = {&CPU::ASL, &CPU::absoluteX, 7, false};
+    table[0x4A] = {&CPU::LSR, &CPU::accumulator, 2};
+    table[0x46] = {&CPU::LSR, &CPU::zeropage, 5};
+    table[0x56] = {&CPU::LSR, &CPU::zeropageX, 6};
+    table[0x4E] = {&CPU::LSR, &CPU::absolute, 6};
+    table[0x5E] = {&CPU::LSR, &CPU::absoluteX, 7, false};
+    // table[0x2A] = {&CPU::ROL, &CPU::accumulator, 2};
+    // table[0x26] = {&CPU::ROL, &CPU::zeropage, 5};
+    // table[0x36] = {&CPU::ROL, &CPU::zeropageX, 6};
+    // table[0x2E] = {&CPU::ROL, &CPU::absolute, 6};
+    // table[0x3E] = {&CPU::ROL, &CPU::absoluteX, 7};
+    //* Flag Instructions *//
+    table[0x18] = {&CPU::CLC, &CPU::implied, 2};
+    table[0xD8] = {&CPU::CLD, &CPU::implied, 2};
+    table[0x58] = {&CPU::CLI, &CPU::implied, 2};
+    table[0xB8] = {&CPU::CLV, &CPU::implied, 2};
+    table[0x38] = {&CPU::SEC, &CPU::implied, 2};
+    table[0xF8] = {&CPU::SED, &CPU::implied, 2};
+    table[0x78] = {&CPU::SEI, &CPU::implied, 2};
+    //* Comparisons *//
+    table[0xC9] = {&CPU::CMP, &CPU::immediate, 2};
+    table[0xC5] = {&CPU::CMP, &CPU::zeropage, 3};
+    table[0xD5] = {&CPU::CMP, &CPU::zeropageX, 4};
+    table[0xCD] = {&CPU::CMP, &CPU::absolute, 4};
+    table[0xDD] = {&CPU::CMP, &CPU::absoluteX, 4};
+    table[0xD9] = {&CPU::CMP, &CPU::absoluteY, 4};
+    table[0xC1] = {&CPU::CMP, &CPU::indirectX, 6};
+    table[0xD1] = {&CPU::CMP, &CPU::indirectY, 5};
+    table[0xE0] = {&CPU::CPX, &CPU::immediate, 2};
+    table[0xE4] = {&CPU::CPX, &CPU::zeropage, 3};
+    table[0xEC] = {&CPU::CPX, &CPU::absolute, 4};
+    table[0xC0] = {&CPU::CPY, &CPU::immediate, 2};
+    table[0xC4] = {&CPU::CPY, &CPU::zeropage, 3};
+    table[0xCC] = {&CPU::CPY, &CPU::absolute, 4};
+    //* Conditional Branching *//
+    table[0x90] = {&CPU::BCC, &CPU::relative, 2};
+    table[0xB0] = {&CPU::BCS, &CPU::relative, 2};
+    table[0xF0] = {&CPU::BEQ, &CPU::relative, 2};
+    table[0x30] = {&CPU::BMI, &CPU::relative, 2};
+    table[0xD0] = {&CPU::BNE, &CPU::relative, 2};
+    table[0x10] = {&CPU::BPL, &CPU::relative, 2};
+    table[0x50] = {&CPU::BVC, &CPU::relative, 2};
+    table[0x70] = {&CPU::BVS, &CPU::relative, 2};
+
+    return table;
+}
+
+alignas(64) constexpr std::array<CPU::Instruction, 256> CPU::lookup = CPU::build_lookup();
+
+CPU::CPU(Memory *memory) : BasicCPU(memory)
+{
+    core = TABLE;
+    jit_threshold = 16;
+    jit_generation = 0;
+    program = nullptr;
+    fusions_enabled = ~0u;
+    fused = {0, 0, 0, std::vector<std::uint64_t>(fusions().size())};
+    elide_flags = true;
+    elided = {0, 0, 0, 0};
+    skip_idle = true;
+    idled = {0, 0};
+    page_crossed = false;
+    effective_address = 0x0000;
+}
 
-//* Get functions *//
+void CPU::reset()
+{
+    memory->reset();
+    reset_registers();
+}
 
-Byte CPU::getA() const { return A; }
-Byte CPU::getX() const { return X; }
-Byte CPU::getY() const { return Y; }
-Byte CPU::getSP() const { return SP; }
-Byte CPU::getSR() const { return SR; }
-Word CPU::getPC() const { return PC; }
-Word CPU::getCycles() const { return clock_cycles; }
+void CPU::reset_registers()
+{
+    BasicCPU::reset_registers();
+    page_crossed = false;
+    effective_address = 0x0000;
+}
+
+void CPU::setEngine(engine e)
+{
+    core = e;
+    if ((core == CACHED || core == JIT) && !cache)
+    {
+        cache = std::make_unique<BlockCache>(memory);
+        fused = {0, 0, 0, std::vector<std::uint64_t>(fusions().size())};
+        elided = {0, 0, 0, 0};
+        idled = {0, 0};
+    }
+    else if (core != CACHED && core != JIT)
+    {
+        cache.reset();
+    }
 
-//* Set functions *//
+    if (core == JIT && !jit)
+    {
+        jit = std::make_unique<Jit>();
+        jit_generation = cache->generation();
+        if (jit->available())
+        {
+            jit_trampolines();
+        }
+    }
+    else if (core != JIT)
+    {
+        jit.reset();
+    }
+}
 
-void CPU::setA(Byte b) { A = b; }
-void CPU::setX(Byte b) { X = b; }
-void CPU::setY(Byte b) { Y = b; }
-void CPU::setSP(Byte b) { SP = b; }
-void CPU::setSR(Byte b) { SR = b; }
-void CPU::setPC(Word address) { PC = address; }
+void CPU::setJitThreshold(std::uint32_t entries) { jit_threshold = entries; }
 
-CPU::CPU(Memory *memory)
+void CPU::setRecompiled(recompiled program) { this->program = program; }
+
+jit_stats CPU::getJitStats() const
 {
-    this->memory = memory;
-    A = X = Y = 0x00;
-    SP = 0xFF;
-    SR = 0x00;
-    PC = 0x0000;
+    return jit ? jit->stats : jit_stats{0, 0, 0, 0};
+}
 
-    clock_cycles = 0;
-    interrupt = false;
-    effective_address = 0x0000;
+cache_stats CPU::getCacheStats() const
+{
+    return cache ? cache->getStats() : cache_stats{0, 0, 0};
 }
+CPU::engine CPU::getEngine() const { return core; }
 
-void CPU::reset()
+void CPU::run()
 {
-    memory->reset();
-    A = X = Y = 0x00;
-    SP = 0xFF;
-    SR = 0x00;
-    PC = 0x0000;
+    dispatch(UINT64_MAX, -1);
+}
 
-    clock_cycles = 0;
-    interrupt = false;
-    effective_address = 0x0000;
+std::uint64_t CPU::step()
+{
+    // every implemented instruction takes at least one cycle
+    return dispatch(clock_cycles + 1, -1);
 }
 
-void CPU::run()
+std::uint64_t CPU::run_for(std::uint64_t cycles)
+{
+    return dispatch(limit_after(cycles), -1);
+}
+
+std::uint64_t CPU::run_until(Word address, std::uint64_t max_cycles)
+{
+    return dispatch(limit_after(max_cycles), address);
+}
+
+std::uint64_t CPU::dispatch(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    std::uint64_t start = clock_cycles;
+    if (program != nullptr)
+    {
+        run_recompiled(cycle_limit, stop_at);
+    }
+    else
+    {
+        run_engine(cycle_limit, stop_at);
+    }
+    return clock_cycles - start;
+}
+
+void CPU::run_engine(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    switch (core)
+    {
+    case SWITCH:
+        run_switch(cycle_limit, stop_at);
+        break;
+    case CACHED:
+        run_cached(cycle_limit, stop_at);
+        break;
+    case JIT:
+        run_jit(cycle_limit, stop_at);
+        break;
+    case LAZY:
+        run_switch<true>(cycle_limit, stop_at);
+        break;
+    default:
+        run_table(cycle_limit, stop_at);
+        break;
+    }
+}
+
+void CPU::run_recompiled(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    while (!interrupt && clock_cycles < cycle_limit && PC != stop_at)
+    {
+        if (!program(*this, cycle_limit, stop_at))
+        {
+            // code the recompiler never saw: interpret one instruction
+            run_engine(clock_cycles + 1, stop_at);
+        }
+    }
+}
+
+void CPU::run_table(std::uint64_t cycle_limit, std::int32_t stop_at)
 {
-    while (!interrupt)
+    while (!interrupt && clock_cycles < cycle_limit && PC != stop_at)
     {
         opcode = memory->read(PC);
         PC++;
 
-        auto it = lookup.find(opcode);
-        // lookup[opcode] has undesired behavior if opcode does not exist in the map
-        Instruction ins = it->second;
+        const Instruction &ins = lookup[opcode];
 
         // how to keep track of cycles
         (this->*ins.addressing)();
@@ -62,6 +330,14 @@ void CPU::run()
         // what is this syntax?
         (this->*ins.execute)();
         clock_cycles += ins.cycles;
+
+        // only reads pay for crossing a page; stores and read-modify-write
+        // instructions already include the extra cycle in their base count
+        if (page_crossed && ins.page_penalty)
+        {
+            clock_cycles++;
+        }
+        page_crossed = false;
     }
 }
 
@@ -84,10 +360,8 @@ bool CPU::flag_is_set(flags f)
 
 Byte CPU::accumulator()
 {
-    // value at PC will just be A, indicating
-    // to perform a bit shift on the accumulator.
-    // so we just increment the PC.
-    PC++;
+    // the operand is A itself, so there is nothing to fetch;
+    // the handler checks the opcode to pick the accumulator.
     return 0;
 }
 
@@ -105,6 +379,8 @@ Byte CPU::implied()
 
 Byte CPU::relative()
 {
+    effective_address = PC;
+    PC++;
     return 0;
 }
 
@@ -134,13 +410,8 @@ Byte CPU::zeropageY()
 
 Byte CPU::absolute()
 {
-    Word low_byte = memory->read(PC);
-    PC++;
-
-    Word high_byte = memory->read(PC);
-    PC++;
-
-    effective_address = (high_byte << 8) | low_byte;
+    effective_address = memory->read_word(PC);
+    PC += 2;
     return 0;
 }
 
@@ -155,7 +426,7 @@ Byte CPU::absoluteX()
     if ((low_byte + (Word)X) > 0xFF)
     {
         // overflow between the low bytes indicated page boundary is crossed
-        clock_cycles++;
+        page_crossed = true;
     }
 
     effective_address = ((high_byte << 8) | low_byte) + X;
@@ -173,7 +444,7 @@ Byte CPU::absoluteY()
     if ((low_byte + (Word)Y) > 0xFF)
     {
         // overflow between the low bytes indicated page boundary is crossed
-        clock_cycles++;
+        page_crossed = true;
     }
 
     effective_address = ((high_byte << 8) | low_byte) + Y;
@@ -182,34 +453,26 @@ Byte CPU::absoluteY()
 
 Byte CPU::indirectX()
 {
-    Byte low_byte = memory->read(PC) + X;
+    Byte pointer = memory->read(PC) + X;
     PC++;
 
-    Word lookup_address = 0x0000 | low_byte;
-    low_byte = memory->read(lookup_address);
-    Word high_byte = memory->read(lookup_address + 1);
-
-    effective_address = (high_byte << 8) | low_byte;
+    effective_address = zeropage_word(pointer);
     return 0;
 }
 
 Byte CPU::indirectY()
 {
-    Word low_byte = memory->read(PC);
+    Byte pointer = memory->read(PC);
     PC++;
 
-    Word lookup_address = 0x0000 | low_byte;
-
-    low_byte = memory->read(lookup_address);
-    Word high_byte = memory->read(lookup_address + 1);
-
-    if ((low_byte + (Word)Y) > 0xFF)
+    Word base = zeropage_word(pointer);
+    if (((base & 0xFF) + (Word)Y) > 0xFF)
     {
         // overflow between the low bytes indicates page boundary is crossed
-        clock_cycles++;
+        page_crossed = true;
     }
 
-    effective_address = ((high_byte << 8) | low_byte) + Y;
+    effective_address = base + Y;
     return 0;
 }
 
@@ -220,6 +483,11 @@ void CPU::BRK()
     interrupt = true;
 }
 
+void CPU::ILL()
+{
+    trap();
+}
+
 void CPU::modify_negative_flag(Byte data)
 {
     if (data & 0x80)
@@ -409,44 +677,15 @@ void CPU::INY()
 
 //* Arithmetic Operations *//
 
-// needs tests
+// binary or decimal, as the D flag says; shares the fused engines' arithmetic
 void CPU::ADC()
 {
-    Word data = (memory->read(effective_address));
-
-    Word value = (Word)A + data + (Word)flag_is_set(CARRY);
-    if (value > 0xFF)
-    {
-        set(CARRY);
-    }
-    if (~(data ^ (Word)A) & ((Word)A ^ value) & 0x0080)
-    {
-        set(OVERFLOW);
-    }
-    modify_negative_flag(value);
-    modify_zero_flag(value);
-
-    A = value & 0x00FF;
+    add(memory->read(effective_address));
 }
 
-// needs tests
 void CPU::SBC()
 {
-    Word data = (memory->read(effective_address)) ^ 0x00FF;
-
-    Word value = (Word)A + data + (Word)flag_is_set(CARRY);
-    if (value & 0xFF00)
-    {
-        set(CARRY);
-    }
-    if ((value ^ (Word)A) & (value & data) & 0x0080)
-    {
-        set(OVERFLOW);
-    }
-    modify_negative_flag(value);
-    modify_zero_flag(value);
-
-    A = value & 0x00FF;
+    subtract(memory->read(effective_address));
 }
 
 //* Logical Operations *//
@@ -492,7 +731,7 @@ void CPU::ASL()
             clear(CARRY);
         }
 
-        A << 1;
+        A <<= 1;
         modify_negative_flag(A);
         modify_zero_flag(A);
         return;
@@ -507,7 +746,7 @@ void CPU::ASL()
         clear(CARRY);
     }
 
-    data << 1;
+    data <<= 1;
     modify_negative_flag(data);
     modify_zero_flag(data);
     memory->write(effective_address, data);
@@ -527,7 +766,8 @@ void CPU::LSR()
             clear(CARRY);
         }
 
-        A >> 1;
+        A >>= 1;
+        modify_negative_flag(A);
         modify_zero_flag(A);
         return;
     }
@@ -542,7 +782,8 @@ void CPU::LSR()
         clear(CARRY);
     }
 
-    data >> 1;
+    data >>= 1;
+    modify_negative_flag(data);
     modify_zero_flag(data);
     memory->write(effective_address, data);
 }
@@ -654,154 +895,60 @@ void CPU::CPY()
     }
 }
 
-void CPU::BCC()
+void CPU::branch(bool condition)
 {
-    if (!flag_is_set(CARRY))
+    if (condition)
     {
-        // jump
-        Byte offset = memory->read(PC);
+        // offset is signed and relative to the following instruction
+        Word target = PC + static_cast<std::int8_t>(memory->read(effective_address));
 
         // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
+        if ((PC & 0xFF00) != (target & 0xFF00))
         {
             clock_cycles++;
         }
 
-        // Update PC with the new value
-        PC += offset;
+        PC = target;
         clock_cycles++;
     }
 }
 
-void CPU::BCS()
+void CPU::BCC()
 {
-    if (flag_is_set(CARRY))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
+    branch(!flag_is_set(CARRY));
+}
 
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+void CPU::BCS()
+{
+    branch(flag_is_set(CARRY));
 }
 
 void CPU::BEQ()
 {
-    if (flag_is_set(ZERO))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(flag_is_set(ZERO));
 }
 
 void CPU::BMI()
 {
-    if (flag_is_set(NEGATIVE))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(flag_is_set(NEGATIVE));
 }
 
 void CPU::BNE()
 {
-    if (!flag_is_set(ZERO))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(!flag_is_set(ZERO));
 }
 
 void CPU::BPL()
 {
-    if (!flag_is_set(NEGATIVE))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(!flag_is_set(NEGATIVE));
 }
 
 void CPU::BVC()
 {
-    if (!flag_is_set(OVERFLOW))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(!flag_is_set(OVERFLOW));
 }
 
 void CPU::BVS()
 {
-    if (flag_is_set(OVERFLOW))
-    {
-        // jump
-        Byte offset = memory->read(PC);
-
-        // Check if crossing a page boundary
-        if ((PC & 0xFF00) != ((PC + offset) & 0xFF00))
-        {
-            clock_cycles++;
-        }
-
-        // Update PC with the new value
-        PC += offset;
-        clock_cycles++;
-    }
+    branch(flag_is_set(OVERFLOW));
 }
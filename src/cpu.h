@@ -1,198 +1,67 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <map>
+#include <vector>
 
+#include "block_cache.h"
+#include "jit.h"
 #include "memory.h"
 #include "types.h"
 
 // Instruction Set: https://www.masswerk.at/6502/6502_instruction_set.html
 
-class CPU
+// Registers, the (op, mode) policies and the fused switch engine, generic
+// over the bus. A bus provides read(Word), write(Word, Byte), read_word(Word)
+// (little-endian) and reset(); defined inline, every operand fetch and data
+// access compiles down to the bus's own loads and stores with no call.
+// FlatMemory is the RAM-only bus; CPU below runs on Memory and adds the
+// table, cached, JIT and recompiled engines. The policies live in cpu_ops.h,
+// and the library instantiates BasicCPU for Memory and FlatMemory.
+class SaveState;
+class Rewind;
+class Lockstep;
+
+template <class Bus>
+class BasicCPU
 {
-private:
-    Memory *memory;
+    friend class SaveState; // these three restore cycles and the halt state
+    friend class Rewind;
+    friend class Lockstep;
+
+protected:
+    Bus *memory;
     Byte A, X, Y; // Accumulator, X, Y registers
     Byte SP;      // stack pointer
     Byte SR;      // status register
     Word PC;      // program counter
 
-    Word clock_cycles;
-
-    struct Instruction
-    {
-        void (CPU::*execute)(void);
-        Byte (CPU::*addressing)(void);
-        Byte cycles;
-    };
-
-    // is it okay to define this here?
-    // Instruction opcode maps to {Mneomnic, Addressing Mode, Num. of clock cycles}
-    std::map<Byte, Instruction> lookup = {
-        {0x00, {&CPU::BRK, &CPU::implied, 7}},
-        //* LDA OPCODES *//
-        {0xA9, {&CPU::LDA, &CPU::immediate, 2}},
-        {0xA5, {&CPU::LDA, &CPU::zeropage, 3}},
-        {0xB5, {&CPU::LDA, &CPU::zeropageX, 4}},
-        {0xAD, {&CPU::LDA, &CPU::absolute, 4}},
-        {0xBD, {&CPU::LDA, &CPU::absoluteX, 4}},
-        {0xB9, {&CPU::LDA, &CPU::absoluteY, 4}},
-        {0xA1, {&CPU::LDA, &CPU::indirectX, 6}},
-        {0xB1, {&CPU::LDA, &CPU::indirectY, 5}},
-        //* LDX OPCODES *//
-        {0xA2, {&CPU::LDX, &CPU::immediate, 2}},
-        {0xA6, {&CPU::LDX, &CPU::zeropage, 3}},
-        {0xB6, {&CPU::LDX, &CPU::zeropageY, 4}},
-        {0xAE, {&CPU::LDX, &CPU::absolute, 4}},
-        {0xBE, {&CPU::LDX, &CPU::absoluteY, 4}},
-        //* LDY OPCODES *//
-        {0xA0, {&CPU::LDY, &CPU::immediate, 2}},
-        {0xA4, {&CPU::LDY, &CPU::zeropage, 3}},
-        {0xB4, {&CPU::LDY, &CPU::zeropageX, 4}},
-        {0xAC, {&CPU::LDY, &CPU::absolute, 4}},
-        {0xBC, {&CPU::LDY, &CPU::absoluteX, 4}},
-        //* STA OPCODES *//
-        {0x85, {&CPU::STA, &CPU::zeropage, 3}},
-        {0x95, {&CPU::STA, &CPU::zeropageX, 4}},
-        {0x8D, {&CPU::STA, &CPU::absolute, 4}},
-        {0x9D, {&CPU::STA, &CPU::absoluteX, 5}},
-        {0x99, {&CPU::STA, &CPU::absoluteY, 5}},
-        {0x81, {&CPU::STA, &CPU::indirectX, 6}},
-        {0x91, {&CPU::STA, &CPU::indirectY, 6}},
-        //* STX OPCODES *//
-        {0x86, {&CPU::STX, &CPU::zeropage, 3}},
-        {0x96, {&CPU::STX, &CPU::zeropageY, 4}},
-        {0x8E, {&CPU::STX, &CPU::absolute, 4}},
-        //* STY OPCODES *//
-        {0x84, {&CPU::STY, &CPU::zeropage, 3}},
-        {0x94, {&CPU::STY, &CPU::zeropageX, 4}},
-        {0x8C, {&CPU::STY, &CPU::absolute, 4}},
-        //* T__ OPCODES *//
-        {0xAA, {&CPU::TAX, &CPU::implied, 2}},
-        {0xA8, {&CPU::TAY, &CPU::implied, 2}},
-        {0xBA, {&CPU::TSX, &CPU::implied, 2}},
-        {0x8A, {&CPU::TXA, &CPU::implied, 2}},
-        {0x9A, {&CPU::TXS, &CPU::implied, 2}},
-        {0x98, {&CPU::TYA, &CPU::implied, 2}},
-        //* Stack OPCODES *//
-        {0x48, {&CPU::PHA, &CPU::implied, 3}},
-        {0x08, {&CPU::PHP, &CPU::implied, 3}},
-        {0x68, {&CPU::PLA, &CPU::implied, 4}},
-        {0x28, {&CPU::PLP, &CPU::implied, 4}},
-        //* Decrements & Increments *//
-        {0xC6, {&CPU::DEC, &CPU::zeropage, 5}},
-        {0xD6, {&CPU::DEC, &CPU::zeropageX, 6}},
-        {0xCE, {&CPU::DEC, &CPU::absolute, 6}},
-        {0xDE, {&CPU::DEC, &CPU::absoluteX, 7}},
-        {0xCA, {&CPU::DEX, &CPU::implied, 2}},
-        {0x88, {&CPU::DEY, &CPU::implied, 2}},
-        {0xE6, {&CPU::INC, &CPU::zeropage, 5}},
-        {0xF6, {&CPU::INC, &CPU::zeropageX, 6}},
-        {0xEE, {&CPU::INC, &CPU::absolute, 6}},
-        {0xFE, {&CPU::INC, &CPU::absoluteX, 7}},
-        {0xE8, {&CPU::INX, &CPU::implied, 2}},
-        {0xC8, {&CPU::INY, &CPU::implied, 2}},
-        //* Arithmetic Operations *//
-        {0x69, {&CPU::ADC, &CPU::implied, 2}},
-        {0x65, {&CPU::ADC, &CPU::zeropage, 3}},
-        {0x75, {&CPU::ADC, &CPU::zeropageX, 4}},
-        {0x6D, {&CPU::ADC, &CPU::absolute, 4}},
-        {0x7D, {&CPU::ADC, &CPU::absoluteX, 4}},
-        {0x79, {&CPU::ADC, &CPU::absoluteY, 4}},
-        {0x61, {&CPU::ADC, &CPU::indirectX, 6}},
-        {0x71, {&CPU::ADC, &CPU::indirectY, 5}},
-        {0xE9, {&CPU::SBC, &CPU::implied, 2}},
-        {0xE5, {&CPU::SBC, &CPU::zeropage, 3}},
-        {0xF5, {&CPU::SBC, &CPU::zeropageX, 4}},
-        {0xED, {&CPU::SBC, &CPU::absolute, 4}},
-        {0xFD, {&CPU::SBC, &CPU::absoluteX, 4}},
-        {0xF9, {&CPU::SBC, &CPU::absoluteY, 4}},
-        {0xE1, {&CPU::SBC, &CPU::indirectX, 6}},
-        {0xF1, {&CPU::SBC, &CPU::indirectY, 5}},
-        //* Logical Operations *//
-        {0x29, {&CPU::AND, &CPU::immediate, 2}},
-        {0x25, {&CPU::AND, &CPU::zeropage, 3}},
-        {0x35, {&CPU::AND, &CPU::zeropageX, 4}},
-        {0x2D, {&CPU::AND, &CPU::absolute, 4}},
-        {0x3D, {&CPU::AND, &CPU::absoluteX, 4}},
-        {0x39, {&CPU::AND, &CPU::absoluteY, 4}},
-        {0x21, {&CPU::AND, &CPU::indirectX, 6}},
-        {0x31, {&CPU::AND, &CPU::indirectY, 5}},
-        {0x49, {&CPU::EOR, &CPU::immediate, 2}},
-        {0x45, {&CPU::EOR, &CPU::zeropage, 3}},
-        {0x55, {&CPU::EOR, &CPU::zeropageX, 4}},
-        {0x4D, {&CPU::EOR, &CPU::absolute, 4}},
-        {0x5D, {&CPU::EOR, &CPU::absoluteX, 4}},
-        {0x59, {&CPU::EOR, &CPU::absoluteY, 4}},
-        {0x41, {&CPU::EOR, &CPU::indirectX, 6}},
-        {0x51, {&CPU::EOR, &CPU::indirectY, 5}},
-        {0x09, {&CPU::ORA, &CPU::immediate, 2}},
-        {0x05, {&CPU::ORA, &CPU::zeropage, 3}},
-        {0x15, {&CPU::ORA, &CPU::zeropageX, 4}},
-        {0x0D, {&CPU::ORA, &CPU::absolute, 4}},
-        {0x1D, {&CPU::ORA, &CPU::absoluteX, 4}},
-        {0x19, {&CPU::ORA, &CPU::absoluteY, 4}},
-        {0x01, {&CPU::ORA, &CPU::indirectX, 6}},
-        {0x11, {&CPU::ORA, &CPU::indirectY, 5}},
-        //* Shift & Rotate *//
-        {0x0A, {&CPU::ASL, &CPU::accumulator, 2}},
-        {0x06, {&CPU::ASL, &CPU::zeropage, 5}},
-        {0x16, {&CPU::ASL, &CPU::zeropageX, 6}},
-        {0x0E, {&CPU::ASL, &CPU::absolute, 6}},
-        {0x1E, {&CPU::ASL, &CPU::absoluteX, 7}},
-        {0x4A, {&CPU::LSR, &CPU::accumulator, 2}},
-        {0x46, {&CPU::LSR, &CPU::zeropage, 5}},
-        {0x56, {&CPU::LSR, &CPU::zeropageX, 6}},
-        {0x4E, {&CPU::LSR, &CPU::absolute, 6}},
-        {0x5E, {&CPU::LSR, &CPU::absoluteX, 7}},
-        // {0x2A, {&CPU::ROL, &CPU::accumulator, 2}},
-        // {0x26, {&CPU::ROL, &CPU::zeropage, 5}},
-        // {0x36, {&CPU::ROL, &CPU::zeropageX, 6}},
-        // {0x2E, {&CPU::ROL, &CPU::absolute, 6}},
-        // {0x3E, {&CPU::ROL, &CPU::absoluteX, 7}},
-        //* Flag Instructions *//
-        {0x18, {&CPU::CLC, &CPU::implied, 2}},
-        {0xD8, {&CPU::CLD, &CPU::implied, 2}},
-        {0x58, {&CPU::CLI, &CPU::implied, 2}},
-        {0xB8, {&CPU::CLV, &CPU::implied, 2}},
-        {0x38, {&CPU::SEC, &CPU::implied, 2}},
-        {0xF8, {&CPU::SED, &CPU::implied, 2}},
-        {0x78, {&CPU::SEI, &CPU::implied, 2}},
-        //* Comparisons *//
-        {0xC9, {&CPU::CMP, &CPU::immediate, 2}},
-        {0xC5, {&CPU::CMP, &CPU::zeropage, 3}},
-        {0xD5, {&CPU::CMP, &CPU::zeropageX, 4}},
-        {0xCD, {&CPU::CMP, &CPU::absolute, 4}},
-        {0xDD, {&CPU::CMP, &CPU::absoluteX, 4}},
-        {0xD9, {&CPU::CMP, &CPU::absoluteY, 4}},
-        {0xC1, {&CPU::CMP, &CPU::indirectX, 6}},
-        {0xD1, {&CPU::CMP, &CPU::indirectY, 5}},
-        {0xE0, {&CPU::CPX, &CPU::immediate, 2}},
-        {0xE4, {&CPU::CPX, &CPU::zeropage, 3}},
-        {0xEC, {&CPU::CPX, &CPU::absolute, 4}},
-        {0xC0, {&CPU::CPY, &CPU::immediate, 2}},
-        {0xC4, {&CPU::CPY, &CPU::zeropage, 3}},
-        {0xCC, {&CPU::CPY, &CPU::absolute, 4}},
-        //* Conditional Branching *//
-        {0x90, {&CPU::BCC, &CPU::relative, 2}},
-        {0xB0, {&CPU::BCS, &CPU::relative, 2}},
-        {0xF0, {&CPU::BEQ, &CPU::relative, 2}},
-        {0x30, {&CPU::BMI, &CPU::relative, 2}},
-        {0xD0, {&CPU::BNE, &CPU::relative, 2}},
-        {0x10, {&CPU::BPL, &CPU::relative, 2}},
-        {0x50, {&CPU::BVC, &CPU::relative, 2}},
-        {0x70, {&CPU::BVS, &CPU::relative, 2}},
-    };
+    std::uint64_t clock_cycles; // total cycles since reset
 
     bool interrupt;
     Byte opcode;
-    Word effective_address;
+
+    // LAZY engine only: the last N/Z-setting result, normally result * 0x0101
+    // (bit 15 gives N, a zero low byte gives Z), folded into SR on the way out
+    Word nz;
 
 public:
-    CPU(Memory *memory);
-    void reset();
-    void run();
+    BasicCPU(Bus *memory);
+    void reset();           // registers and memory
+    void reset_registers(); // registers only; memory is left as it is
+    void run(); // run until BRK (or an unimplemented opcode)
+
+    // Budgeted entry points for hosts that interleave the CPU with other
+    // work. Each returns the cycles actually consumed. Instructions are never
+    // split, so run_for() may overshoot the budget by the last instruction.
+    std::uint64_t step();                        // execute one instruction
+    std::uint64_t run_for(std::uint64_t cycles); // execute until the budget is spent
+    std::uint64_t run_until(Word address,        // execute until PC == address
+                            std::uint64_t max_cycles = UINT64_MAX);
+    bool halted() const; // BRK or ILL stopped execution; reset() clears it
 
     enum flags : Byte
     {
@@ -206,12 +75,237 @@ public:
         CARRY = 1 << 0      // used as buffer and borrow in arithmetic ops
     };
 
+    // How the policies deliver the flags an instruction produces
+    enum flag_mode : Byte
+    {
+        EAGER_FLAGS = 0, // every flag straight into SR
+        LAZY_NZ = 1,     // N/Z recorded in nz (the LAZY engine)
+        DEAD_NZ = 2,     // N/Z not worked out: overwritten before anything reads them
+        DEAD_CV = 4      // C/V not worked out, likewise
+    };
+
+    //** Get functions **//
+
+    Byte getA() const;  // get the value in the A register
+    Byte getX() const;  // get the value in the X register
+    Byte getY() const;  // get the value in the Y register
+    Byte getSP() const; // get the value of the stack pointer
+    Byte getSR() const; // get the value of the status register
+    Word getPC() const; // get the value of the program counter
+    std::uint64_t getCycles() const;
+    // const means it will not modify state of object
+
+    //** Set functions **//
+
+    void setA(Byte b);        // set the value of the A register
+    void setX(Byte b);        // set the value of the X register
+    void setY(Byte b);        // set the value of the Y register
+    void setSP(Byte b);       // set the value fo the stack pointer
+    void setSR(Byte b);       // set the value of the statuts register
+    void setPC(Word address); // set the value of the program counter
+
+protected:
+    // Engines run until halted, clock_cycles reaches cycle_limit, or PC
+    // equals stop_at (which is out of Word range when there is no stop).
+    std::uint64_t dispatch(std::uint64_t cycle_limit, std::int32_t stop_at);
+    template <bool Lazy = false>
+    void run_switch(std::uint64_t cycle_limit, std::int32_t stop_at);
+    std::uint64_t limit_after(std::uint64_t cycles) const; // saturating clock_cycles + cycles
+
+    //** Fused Engine Helpers (cpu_ops.h) **//
+
+    struct mode; // addressing mode policies
+    struct op;   // operation policies
+
+    template <class Op, class Mode, Byte Cycles, Byte Flags = EAGER_FLAGS>
+    void execute(); // one opcode: fetch operand, apply op, count cycles
+
+    Byte fetch();
+    Word fetch_word();
+    template <int Length>
+    Word fetch_operand();
+    Word zeropage_word(Byte address); // pointer in page zero, wrapping at $FF
+    void page_cross(Word base, Word address);
+    template <Byte Flags = EAGER_FLAGS>
+    Byte transfer(Byte data); // update N/Z from data and pass it through
+    template <Byte Flags = EAGER_FLAGS>
+    void assign_nz(Byte negative, Byte zero); // N from bit 7 of negative, Z from zero == 0
+    template <Byte Flags = EAGER_FLAGS>
+    bool test(flags f) const; // f is set in SR, or in nz for N/Z when LAZY_NZ
+    void materialize_flags(); // SR's N/Z from nz
+    void defer_flags();       // nz from SR's N/Z
+    template <Byte Flags = EAGER_FLAGS>
+    void assign_cv(Byte flags); // C and V from flags (as in SR), unless DEAD_CV
+    void assign(flags f, bool value);
+    void push(Byte data);
+    Byte pull();
+    template <Byte Flags = EAGER_FLAGS>
+    void add(Byte data);
+    template <Byte Flags = EAGER_FLAGS>
+    void subtract(Byte data);
+    template <Byte Flags = EAGER_FLAGS>
+    Byte shift_left(Byte data);
+    template <Byte Flags = EAGER_FLAGS>
+    Byte shift_right(Byte data);
+    template <Byte Flags = EAGER_FLAGS>
+    void compare(Byte reg, Byte data);
+    void branch_to(bool condition, Byte offset);
+    void trap(); // unimplemented opcode: halt with PC on it
+};
+
+extern template class BasicCPU<Memory>;
+extern template class BasicCPU<FlatMemory>;
+extern template void BasicCPU<Memory>::run_switch<true>(std::uint64_t cycle_limit, std::int32_t stop_at);
+
+class CPU : public BasicCPU<Memory>
+{
+private:
+    struct Instruction
+    {
+        void (CPU::*execute)(void);
+        Byte (CPU::*addressing)(void);
+        Byte cycles;
+        bool page_penalty = true; // +1 cycle when an indexed read crosses a page
+    };
+
+    // Opcode maps to {Mnemonic, Addressing Mode, Num. of clock cycles}.
+    // One table shared by every CPU, built at compile time; opcodes we do
+    // not implement land on ILL instead of an invalid lookup.
+    static constexpr std::array<Instruction, 256> build_lookup();
+    alignas(64) static const std::array<Instruction, 256> lookup;
+
+    bool page_crossed;
+    Word effective_address;
+
+public:
+    CPU(Memory *memory);
+    void reset();
+    void reset_registers();
+
+    // as in BasicCPU, but through the selected engine
+    void run();
+    std::uint64_t step();
+    std::uint64_t run_for(std::uint64_t cycles);
+    std::uint64_t run_until(Word address, std::uint64_t max_cycles = UINT64_MAX);
+
     void set(flags f);
     void clear(flags f);
     bool flag_is_set(flags f);
     void modify_negative_flag(Byte data);
     void modify_zero_flag(Byte data);
+    void branch(bool condition);
+
+    // Execution engines; all run the same instruction set.
+    enum engine : Byte
+    {
+        TABLE,  // lookup table of addressing mode + handler member pointers
+        SWITCH, // one switch with addressing and operation fused per opcode
+        CACHED, // predecoded basic blocks, invalidated when their code is written
+        JIT,    // CACHED, plus hot blocks translated to x86-64 (interprets elsewhere)
+        LAZY    // SWITCH, but N/Z are only worked out when a branch, PHP or the host reads them
+    };
+
+    void setEngine(engine e); // select the execution engine used by run()
+    engine getEngine() const;
+    cache_stats getCacheStats() const; // all zero unless the CACHED or JIT engine is on
+    jit_stats getJitStats() const;     // all zero unless the JIT engine is on
+    void setJitThreshold(std::uint32_t entries); // block entries before translation
+
+    // Superinstructions: opcode pairs and triples that the CACHED and JIT
+    // engines decode into one handler, with the same cycles and flags as
+    // the separate instructions. fusions() lists every sequence there is a
+    // handler for, and all of them are on until setFusions() picks a subset.
+    static std::vector<std::vector<Byte>> fusions();
+    bool setFusions(const std::vector<std::vector<Byte>> &sequences); // false if one has no handler
+    fusion_stats getFusionStats() const; // zero unless the CACHED or JIT engine is on
+
+    // Dead flags: the CACHED engine works out which N/Z and C/V results in
+    // a block are overwritten before a branch, PHP, ADC/SBC, store or the
+    // block's end can see them, and runs those instructions without
+    // computing them. Only a block that cannot stop partway runs this way,
+    // so getSR() between run calls is always exact. On by default.
+    void setFlagElision(bool enabled);
+    elision_stats getElisionStats() const; // zero unless the CACHED or JIT engine is on
+
+    // Idle loops: a block that branches back to itself, stores nothing and
+    // polls only RAM, ROM or steady() devices can only leave once the host
+    // changes memory, which it cannot do before the run call returns. When
+    // the CACHED engine enters one twice with the same registers, it moves
+    // the clock on to the last iteration before the budget runs out, so
+    // cycles, registers and stop points are those of spinning. On by default.
+    void setIdleSkipping(bool enabled);
+    idle_stats getIdleStats() const; // zero unless the CACHED engine is on
+
+    // Native code generated by the recompiler (6502-aot) for a fixed image.
+    // It runs from any address it knows and returns false for any other PC,
+    // which the selected engine then interprets.
+    typedef bool (*recompiled)(CPU &cpu, std::uint64_t cycle_limit, std::int32_t stop_at);
+    void setRecompiled(recompiled program); // nullptr goes back to the engine alone
+
+    struct aot; // runtime the generated code calls into (aot.h)
+
+private:
+    engine core;
+    std::unique_ptr<BlockCache> cache; // only allocated for the CACHED and JIT engines
+    std::unique_ptr<Jit> jit;          // only allocated for the JIT engine
+    std::uint32_t jit_threshold;
+    std::uint64_t jit_generation; // cache generation the native code was built against
+    recompiled program;
+    std::uint32_t fusions_enabled; // bit i: fusions()[i]
+    fusion_stats fused;
+    bool elide_flags;
+    elision_stats elided;
+    bool skip_idle;
+    idle_stats idled;
+
+    std::uint64_t dispatch(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_engine(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_recompiled(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_table(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_cached(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_jit(std::uint64_t cycle_limit, std::int32_t stop_at);
+    void run_block(const Block &block, std::uint64_t cycle_limit, std::int32_t stop_at);
+    Block decode_block(Word pc);
+
+    struct fusion; // superinstruction table and handlers (cpu_block.cpp)
+    void fuse_block(Block &block);
+    bool runs_whole(const Block &block, std::uint64_t cycle_limit, std::int32_t stop_at) const;
+
+    struct spin // registers as a spinning block was last entered
+    {
+        const Block *block;
+        std::uint64_t generation;
+        std::uint64_t cycles;
+        Byte A, X, Y, SP, SR;
+    };
+    void fast_forward(const Block &block, spin &last, std::uint64_t cycle_limit);
+
+    //** JIT Translation (cpu_jit.cpp) **//
+
+    void jit_trampolines();
+    void *jit_translate(Word pc);
+    bool jit_emit(const DecodedOp &d); // false when the op needs its handler
+    void jit_emit_fallback(const DecodedOp &d);
+    void jit_spill();
+    void jit_reload();
+    void jit_bail_if_al(Word next);
+    void jit_nz(int value);
+    void jit_page_penalty(int address, int base);
+    void jit_address(int mode_id, Word operand, bool penalty);
+    void jit_load(int mode_id, Word operand);
+    void jit_store(int mode_id, Word operand, int reg, Word next);
+    std::int32_t jit_offset(const void *field) const;
 
+    // called from native code
+    static Byte jit_read(CPU *cpu, Word address);
+    static bool jit_write(CPU *cpu, Word address, Byte data); // true if code was invalidated
+    static Word jit_pointer(CPU *cpu, Byte zeropage);
+    static bool jit_fallback(CPU *cpu, void (*handler)(CPU &cpu, Word operand), Word operand, Word next);
+
+    template <class Op, class Mode, Byte Flags = EAGER_FLAGS>
+    static void decoded(CPU &cpu, Word operand); // predecoded form of execute() (cpu_ops.h)
+
+public:
     //** Address Modes **//
 
     Byte accumulator(); // exclusive to bit shifting instructions
@@ -230,6 +324,7 @@ public:
     //** Instruction Handlers **//
 
     void BRK(); // Stop cpu execution.
+    void ILL(); // Trap on an unimplemented opcode.
     void LDA(); // Load A with memory.
     void LDX(); // Load register X with memory.
     void LDY(); // Load register Y with memory.
@@ -279,26 +374,6 @@ public:
     void BPL();
     void BVC();
     void BVS();
-
-    //** Get functions **//
-
-    Byte getA() const;  // get the value in the A register
-    Byte getX() const;  // get the value in the X register
-    Byte getY() const;  // get the value in the Y register
-    Byte getSP() const; // get the value of the stack pointer
-    Byte getSR() const; // get the value of the status register
-    Word getPC() const; // get the value of the program counter
-    Word getCycles() const;
-    // const means it will not modify state of object
-
-    //** Set functions **//
-
-    void setA(Byte b);        // set the value of the A register
-    void setX(Byte b);        // set the value of the X register
-    void setY(Byte b);        // set the value of the Y register
-    void setSP(Byte b);       // set the value fo the stack pointer
-    void setSR(Byte b);       // set the value of the statuts register
-    void setPC(Word address); // set the value of the program counter
 };
 
 #endif // CPU_H
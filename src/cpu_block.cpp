@@ -0,0 +1,428 @@
+#include "aot.h"
+#include "cpu.h"
+#include "cpu_ops.h"
+
+#include <algorithm>
+#include <type_traits>
+
+// Cached engine: decode each basic block once into (handler, operand,
+// next PC, base cycles) entries, then replay it from the BlockCache until a
+// write to one of its code pages drops it. Common instruction pairs and
+// triples are marked as superinstructions and replayed with one dispatch,
+// and instructions whose flags are overwritten unread get handlers that
+// leave them out. Blocks that only poll memory in a loop are skipped
+// ahead to the end of the budget.
+
+//** Superinstructions **//
+
+// A superinstruction runs its instructions back to back through
+// aot::step(), the same work run_block() does for each one, minus the
+// indirect call and the checks in between. run_block() only takes it when
+// none of those checks could fire inside it, so cycles, flags and stop
+// points are exactly those of the separate instructions.
+struct CPU::fusion
+{
+    Byte opcodes[3];
+    Byte length;
+    Byte head_cycles; // worst case before the last instruction starts
+    Byte writes;      // bit k: instruction k stores to its (static) operand address
+    void (*run)(CPU &cpu, const DecodedOp *ops);
+
+    template <Byte Opcode>
+    static constexpr Byte worst_cycles()
+    {
+        using M = typename aot::instruction<Opcode>::addressing;
+        bool indexed = std::is_same<M, mode::absoluteX>::value || std::is_same<M, mode::absoluteY>::value ||
+                       std::is_same<M, mode::indirectY>::value;
+        return aot::instruction<Opcode>::cycles + (indexed ? 1 : 0);
+    }
+
+    template <Byte Opcode>
+    static constexpr bool stores()
+    {
+        using O = typename aot::instruction<Opcode>::operation;
+        return std::is_same<O, op::STA>::value || std::is_same<O, op::STX>::value ||
+               std::is_same<O, op::STY>::value || std::is_same<O, op::INC>::value ||
+               std::is_same<O, op::DEC>::value;
+    }
+
+    template <Byte First, Byte Second>
+    static constexpr fusion pair()
+    {
+        return {{First, Second, 0x00}, 2, worst_cycles<First>(), stores<First>(), [](CPU &cpu, const DecodedOp *ops) {
+                    aot::step<First>(cpu, ops[0].operand, ops[0].next);
+                    aot::step<Second>(cpu, ops[1].operand, ops[1].next);
+                }};
+    }
+
+    template <Byte First, Byte Second, Byte Third>
+    static constexpr fusion triple()
+    {
+        return {{First, Second, Third}, 3, Byte(worst_cycles<First>() + worst_cycles<Second>()),
+                Byte(stores<First>() | stores<Second>() << 1), [](CPU &cpu, const DecodedOp *ops) {
+                    aot::step<First>(cpu, ops[0].operand, ops[0].next);
+                    aot::step<Second>(cpu, ops[1].operand, ops[1].next);
+                    aot::step<Third>(cpu, ops[2].operand, ops[2].next);
+                }};
+    }
+
+    static const std::array<fusion, 18> table;
+};
+
+// loop counters, compares against constants, copies and add/subtract
+// set-up; longer sequences come first, since the first match wins
+constexpr std::array<CPU::fusion, 18> CPU::fusion::table = {
+    triple<0xE8, 0xE0, 0xD0>(), // INX; CPX #; BNE
+    triple<0xC8, 0xC0, 0xD0>(), // INY; CPY #; BNE
+    triple<0xA5, 0x18, 0x69>(), // LDA zp; CLC; ADC #
+    triple<0xA5, 0x38, 0xE9>(), // LDA zp; SEC; SBC #
+    pair<0xCA, 0xD0>(),         // DEX; BNE
+    pair<0x88, 0xD0>(),         // DEY; BNE
+    pair<0xE8, 0xD0>(),         // INX; BNE
+    pair<0xC8, 0xD0>(),         // INY; BNE
+    pair<0xC9, 0xF0>(),         // CMP #; BEQ
+    pair<0xC9, 0xD0>(),         // CMP #; BNE
+    pair<0xE6, 0xD0>(),         // INC zp; BNE
+    pair<0xC6, 0xD0>(),         // DEC zp; BNE
+    pair<0xA5, 0x8D>(),         // LDA zp; STA abs
+    pair<0xAD, 0x8D>(),         // LDA abs; STA abs
+    pair<0xA9, 0x85>(),         // LDA #; STA zp
+    pair<0xA9, 0x8D>(),         // LDA #; STA abs
+    pair<0x18, 0x69>(),         // CLC; ADC #
+    pair<0x38, 0xE9>(),         // SEC; SBC #
+};
+
+std::vector<std::vector<Byte>> CPU::fusions()
+{
+    std::vector<std::vector<Byte>> sequences;
+    for (const fusion &f : fusion::table)
+    {
+        sequences.emplace_back(f.opcodes, f.opcodes + f.length);
+    }
+    return sequences;
+}
+
+bool CPU::setFusions(const std::vector<std::vector<Byte>> &sequences)
+{
+    static_assert(fusion::table.size() <= 32, "fusions_enabled has one bit per entry");
+    bool known = true;
+    fusions_enabled = 0;
+    for (const std::vector<Byte> &sequence : sequences)
+    {
+        std::size_t i = 0;
+        while (i < fusion::table.size() &&
+               !std::equal(sequence.begin(), sequence.end(), fusion::table[i].opcodes,
+                           fusion::table[i].opcodes + fusion::table[i].length))
+        {
+            i++;
+        }
+        if (i == fusion::table.size())
+        {
+            known = false;
+            continue;
+        }
+        fusions_enabled |= 1u << i;
+    }
+    if (cache)
+    {
+        cache->clear(); // blocks decoded with the old set
+    }
+    return known;
+}
+
+fusion_stats CPU::getFusionStats() const
+{
+    return cache ? fused : fusion_stats{0, 0, 0, std::vector<std::uint64_t>(fusion::table.size())};
+}
+
+void CPU::fuse_block(Block &block)
+{
+    std::vector<DecodedOp> &ops = block.ops;
+    for (std::size_t at = 0; at < ops.size(); at++)
+    {
+        for (std::size_t i = 0; i < fusion::table.size(); i++)
+        {
+            const fusion &f = fusion::table[i];
+            if (!(fusions_enabled >> i & 1) || at + f.length > ops.size() ||
+                !std::equal(f.opcodes, f.opcodes + f.length, ops.begin() + at,
+                            [](Byte code, const DecodedOp &d) { return code == d.opcode; }))
+            {
+                continue;
+            }
+
+            // a store into the rest of the sequence must take effect before
+            // that code runs, which only the separate handlers allow
+            bool rewrites = false;
+            for (std::size_t k = 0; k + 1 < f.length; k++)
+            {
+                Word target = ops[at + k].operand;
+                rewrites |= (f.writes >> k & 1) && target >= ops[at + k].next && target < ops[at + f.length - 1].next;
+            }
+            if (rewrites)
+            {
+                continue;
+            }
+
+            ops[at].fused = i + 1;
+            fused.formed++;
+            at += f.length - 1;
+            break;
+        }
+    }
+}
+
+//** Dead Flags **//
+
+void CPU::setFlagElision(bool enabled)
+{
+    elide_flags = enabled;
+    if (cache)
+    {
+        cache->clear(); // blocks decoded with the other handlers
+    }
+}
+
+elision_stats CPU::getElisionStats() const
+{
+    return cache ? elided : elision_stats{0, 0, 0, 0};
+}
+
+// The lean handlers are only exact if the block runs to its last
+// instruction: no budget or stop address inside it. A store may still end
+// it early, which the liveness pass allows for.
+bool CPU::runs_whole(const Block &block, std::uint64_t cycle_limit, std::int32_t stop_at) const
+{
+    if (clock_cycles + block.head_cycles >= cycle_limit)
+    {
+        return false;
+    }
+    return stop_at < 0 || std::none_of(block.ops.begin(), block.ops.end() - 1,
+                                       [stop_at](const DecodedOp &d) { return d.next == stop_at; });
+}
+
+//** Idle Loops **//
+
+void CPU::setIdleSkipping(bool enabled) { skip_idle = enabled; }
+
+idle_stats CPU::getIdleStats() const
+{
+    return cache ? idled : idle_stats{0, 0};
+}
+
+// Entered straight after running itself with the same registers, and with
+// nothing that can write the pages it reads, a spinning block would go
+// round the same way until the budget runs out. Skip to the last iteration
+// that starts within it; running that one stops where spinning would. A
+// stop address inside the loop was already passed on the first iteration.
+void CPU::fast_forward(const Block &block, spin &last, std::uint64_t cycle_limit)
+{
+    spin now = {&block, cache->generation(), clock_cycles, A, X, Y, SP, SR};
+    bool repeated = last.block == now.block && last.generation == now.generation && last.cycles < now.cycles &&
+                    last.A == A && last.X == X && last.Y == Y && last.SP == SP && last.SR == SR;
+    if (repeated && std::all_of(block.pages.begin(), block.pages.end(),
+                                [this](Byte page) { return memory->steady(page); }))
+    {
+        std::uint64_t period = now.cycles - last.cycles;
+        std::uint64_t skip = (cycle_limit - clock_cycles - 1) / period * period;
+        clock_cycles += skip;
+        now.cycles += skip;
+        idled.loops += skip != 0;
+        idled.skipped += skip;
+    }
+    last = now;
+}
+
+//** Decoding **//
+
+Block CPU::decode_block(Word pc)
+{
+    struct Decoder
+    {
+        void (*handlers[4])(CPU &cpu, Word operand); // indexed by (DEAD_NZ | DEAD_CV) >> 1
+        Byte length;
+        Byte cycles;
+        Byte worst_cycles; // with a page crossed
+        bool ends_block;
+        Byte reads;  // flags
+        Byte writes; // flags
+        bool stores;
+        Byte reach; // pages the operand can touch, as mode::reach
+    };
+
+    static constexpr std::array<Decoder, 256> table = [] {
+        std::array<Decoder, 256> t{};
+        for (auto &slot : t)
+        {
+            auto ill = [](CPU &cpu, Word) { cpu.ILL(); };
+            slot = {{ill, ill, ill, ill}, 1, 0, 0, true, 0, 0, false, 0};
+        }
+#define CPU_DECODER(code, mnemonic, addressing, cycles)                                                       \
+    t[code] = {{&CPU::decoded<op::mnemonic, mode::addressing>,                                                \
+                &CPU::decoded<op::mnemonic, mode::addressing, DEAD_NZ>,                                       \
+                &CPU::decoded<op::mnemonic, mode::addressing, DEAD_CV>,                                       \
+                &CPU::decoded<op::mnemonic, mode::addressing, DEAD_NZ | DEAD_CV>},                            \
+               1 + mode::addressing::length, cycles, fusion::worst_cycles<code>(),                           \
+               std::is_same<mode::addressing, mode::relative>::value ||                                       \
+                   std::is_same<op::mnemonic, op::BRK>::value,                                                \
+               op::mnemonic::reads, op::mnemonic::writes,                                                     \
+               op::mnemonic::stores && !std::is_same<mode::addressing, mode::accumulator>::value,            \
+               mode::addressing::reach};
+        CPU_OPCODES(CPU_DECODER)
+#undef CPU_DECODER
+        return t;
+    }();
+
+    Block block;
+    block.start = pc;
+    block.head_cycles = 0;
+    block.lean = false;
+    block.spins = false;
+    while (true)
+    {
+        Byte code = memory->read(pc);
+        const Decoder &d = table[code];
+
+        Word operand = 0;
+        if (d.length > 1)
+        {
+            operand = memory->read(pc + 1);
+        }
+        if (d.length > 2)
+        {
+            operand |= memory->read(pc + 2) << 8;
+        }
+        pc += d.length;
+
+        block.ops.push_back({d.handlers[0], operand, pc, d.cycles, code, 0, d.handlers[0]});
+        if (d.ends_block || block.ops.size() == BlockCache::MAX_BLOCK_OPS)
+        {
+            break;
+        }
+        block.head_cycles += d.worst_cycles;
+    }
+
+    // Flag liveness, backwards from the end of the block, where everything
+    // is live. A store may drop the block's own code and end it there, so
+    // everything is live after one too. PLP sets all of SR at once and is
+    // never lean.
+    const Byte NZ = NEGATIVE | ZERO;
+    const Byte CV = CARRY | OVERFLOW;
+    Byte live = NZ | CV;
+    for (std::size_t i = block.ops.size(); elide_flags && i-- > 0;)
+    {
+        DecodedOp &op = block.ops[i];
+        const Decoder &d = table[op.opcode];
+        if (d.stores)
+        {
+            live = NZ | CV;
+        }
+        Byte dead = 0;
+        if ((d.writes & ~(NZ | CV)) == 0)
+        {
+            dead |= (d.writes & NZ) && !(d.writes & NZ & live) ? DEAD_NZ : 0;
+            dead |= (d.writes & CV) && !(d.writes & CV & live) ? DEAD_CV : 0;
+        }
+        op.lean = d.handlers[dead >> 1];
+        block.lean |= dead != 0;
+        elided.nz += (dead & DEAD_NZ) != 0;
+        elided.cv += (dead & DEAD_CV) != 0;
+        live = (live & ~d.writes) | d.reads;
+    }
+
+    // A spin loop: the block branches back to its own start, and each
+    // iteration depends only on the registers and the pages it reads.
+    // Only branches end a block with a two-byte instruction.
+    const DecodedOp &last = block.ops.back();
+    block.spins = table[last.opcode].ends_block && table[last.opcode].length == 2 &&
+                  Word(last.next + static_cast<std::int8_t>(last.operand)) == block.start;
+    for (const DecodedOp &op : block.ops)
+    {
+        const Decoder &d = table[op.opcode];
+        if (!block.spins || d.stores || d.reach == 3)
+        {
+            block.spins = false;
+            block.pages.clear();
+            break;
+        }
+        if (d.reach > 0)
+        {
+            block.pages.push_back(op.operand >> 8);
+        }
+        if (d.reach > 1)
+        {
+            block.pages.push_back((op.operand >> 8) + 1);
+        }
+        if (op.opcode == 0x68 || op.opcode == 0x28)
+        {
+            block.pages.push_back(0x01); // PLA and PLP read the stack
+        }
+    }
+
+    fuse_block(block);
+    return block;
+}
+
+CPU_FLATTEN void CPU::run_block(const Block &block, std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    std::uint64_t generation = cache->generation();
+    bool lean = block.lean && runs_whole(block, cycle_limit, stop_at);
+    elided.lean += lean;
+    elided.exact += block.lean && !lean;
+    void (*DecodedOp::*handler)(CPU &, Word) = lean ? &DecodedOp::lean : &DecodedOp::handler;
+
+    const DecodedOp *d = block.ops.data();
+    const DecodedOp *end = d + block.ops.size();
+    while (d != end)
+    {
+        const fusion *f = d->fused != 0 ? &fusion::table[d->fused - 1] : nullptr;
+        bool whole = f != nullptr && clock_cycles + f->head_cycles < cycle_limit && d[0].next != stop_at &&
+                     (f->length < 3 || d[1].next != stop_at);
+        if (whole)
+        {
+            f->run(*this, d);
+            fused.executed++;
+            fused.by_sequence[d->fused - 1]++;
+            d += f->length;
+        }
+        else
+        {
+            fused.split += f != nullptr;
+            opcode = d->opcode;
+            PC = d->next;
+            (d->*handler)(*this, d->operand);
+            clock_cycles += d->cycles;
+            d++;
+        }
+
+        // a store into this block's own pages ends it early
+        if (interrupt || clock_cycles >= cycle_limit || PC == stop_at ||
+            cache->generation() != generation)
+        {
+            break;
+        }
+    }
+}
+
+void CPU::run_cached(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    // the host may have changed memory since the last call, so no spin
+    // carries over from it
+    spin last = {nullptr, 0, 0, 0, 0, 0, 0, 0};
+    while (!interrupt && clock_cycles < cycle_limit && PC != stop_at)
+    {
+        const Block *block = cache->find(PC);
+        if (block == nullptr)
+        {
+            block = &cache->insert(decode_block(PC));
+        }
+        if (block->spins && skip_idle)
+        {
+            fast_forward(*block, last, cycle_limit);
+        }
+        else
+        {
+            last.block = nullptr;
+        }
+        run_block(*block, cycle_limit, stop_at);
+    }
+}
@@ -0,0 +1,536 @@
+#include "cpu.h"
+#include "cpu_ops.h"
+
+// JIT engine: blocks from the BlockCache are interpreted until they have been
+// entered jit_threshold times, then translated to x86-64. While native code
+// runs, A/X/Y/SR live in r12-r15, the cycle counter in rbp and the CPU in
+// rbx; every one of those is callee-saved, so memory accesses can call back
+// into Memory (keeping page watches intact) without spilling. Hot simple
+// instructions are emitted inline; the rest call their predecoded handler,
+// which keeps the native path bit-exact with the interpreters by
+// construction. Any invalidation flushes all native code, since chained
+// exits may point into the dropped blocks.
+
+namespace
+{
+enum class jit_op : Byte
+{
+    ADC, AND, ASL, BCC, BCS, BEQ, BMI, BNE, BPL, BRK, BVC, BVS, CLC, CLD, CLI, CLV,
+    CMP, CPX, CPY, DEC, DEX, DEY, EOR, INC, INX, INY, LDA, LDX, LDY, LSR, ORA, PHA,
+    PHP, PLA, PLP, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA
+};
+
+enum class jit_mode : Byte
+{
+    implied, accumulator, immediate, relative, zeropage, zeropageX, zeropageY,
+    absolute, absoluteX, absoluteY, indirectX, indirectY
+};
+
+struct jit_info
+{
+    bool implemented;
+    jit_op op;
+    jit_mode mode;
+};
+
+constexpr std::array<jit_info, 256> make_jit_info()
+{
+    std::array<jit_info, 256> t{};
+#define CPU_JIT_INFO(code, mnemonic, addressing, cycles) \
+    t[code] = {true, jit_op::mnemonic, jit_mode::addressing};
+    CPU_OPCODES(CPU_JIT_INFO)
+#undef CPU_JIT_INFO
+    return t;
+}
+
+constexpr std::array<jit_info, 256> jit_table = make_jit_info();
+
+// 6502 registers while native code runs
+const int REG_A = Jit::R12;
+const int REG_X = Jit::R13;
+const int REG_Y = Jit::R14;
+const int REG_SR = Jit::R15;
+
+// x86 opcodes used with Jit::op_rr (op r/m32, r32)
+const Byte X86_ADD = 0x01;
+const Byte X86_OR = 0x09;
+const Byte X86_AND = 0x21;
+const Byte X86_SUB = 0x29;
+const Byte X86_XOR = 0x31;
+const Byte X86_CMP = 0x39;
+const Byte X86_TEST = 0x85;
+const Byte X86_MOV = 0x89;
+
+const Byte SCRATCH_SLOT = 8; // [rsp + 8], [rsp] holds the cycle limit
+} // namespace
+
+//** Native Helpers **//
+
+Byte CPU::jit_read(CPU *cpu, Word address)
+{
+    return cpu->memory->read(address);
+}
+
+bool CPU::jit_write(CPU *cpu, Word address, Byte data)
+{
+    std::uint64_t generation = cpu->cache->generation();
+    cpu->memory->write(address, data);
+    return cpu->cache->generation() != generation;
+}
+
+Word CPU::jit_pointer(CPU *cpu, Byte zeropage)
+{
+    Word low_byte = cpu->memory->read(zeropage);
+    Word high_byte = cpu->memory->read((Byte)(zeropage + 1));
+    return (high_byte << 8) | low_byte;
+}
+
+bool CPU::jit_fallback(CPU *cpu, void (*handler)(CPU &cpu, Word operand), Word operand, Word next)
+{
+    std::uint64_t generation = cpu->cache->generation();
+    cpu->PC = next;
+    handler(*cpu, operand);
+    return cpu->interrupt || cpu->cache->generation() != generation;
+}
+
+std::int32_t CPU::jit_offset(const void *field) const
+{
+    return static_cast<std::int32_t>(static_cast<const char *>(field) - reinterpret_cast<const char *>(this));
+}
+
+//** Translation **//
+
+void CPU::jit_trampolines()
+{
+    Jit &j = *jit;
+    j.open();
+
+    // enter(cpu, limit, body): save callee-saved registers, load 6502 state
+    j.enter_trampoline = j.here();
+    j.push(Jit::EBX);
+    j.push(Jit::EBP);
+    j.push(Jit::R12);
+    j.push(Jit::R13);
+    j.push(Jit::R14);
+    j.push(Jit::R15);
+    j.emit8(0x48); // sub rsp, 24: limit, scratch, alignment
+    j.emit8(0x83);
+    j.emit8(0xEC);
+    j.emit8(0x18);
+    j.emit8(0x48); // mov [rsp], rsi
+    j.emit8(0x89);
+    j.emit8(0x34);
+    j.emit8(0x24);
+    j.mov_rr64(Jit::EBX, Jit::EDI);
+    jit_reload();
+    j.emit8(0xFF); // jmp rdx
+    j.emit8(0xE2);
+
+    // leave: PC in ax; write 6502 state back and return to the dispatcher
+    j.leave_from_eax = j.here();
+    j.store16(jit_offset(&PC), Jit::EAX);
+    jit_spill();
+    j.emit8(0x48); // add rsp, 24
+    j.emit8(0x83);
+    j.emit8(0xC4);
+    j.emit8(0x18);
+    j.pop(Jit::R15);
+    j.pop(Jit::R14);
+    j.pop(Jit::R13);
+    j.pop(Jit::R12);
+    j.pop(Jit::EBP);
+    j.pop(Jit::EBX);
+    j.emit8(0xC3); // ret
+
+    j.mark_trampolines_end();
+    j.close();
+}
+
+void CPU::jit_spill()
+{
+    jit->store8(jit_offset(&A), REG_A);
+    jit->store8(jit_offset(&X), REG_X);
+    jit->store8(jit_offset(&Y), REG_Y);
+    jit->store8(jit_offset(&SR), REG_SR);
+    jit->store64(jit_offset(&clock_cycles), Jit::EBP);
+}
+
+void CPU::jit_reload()
+{
+    jit->load8(REG_A, jit_offset(&A));
+    jit->load8(REG_X, jit_offset(&X));
+    jit->load8(REG_Y, jit_offset(&Y));
+    jit->load8(REG_SR, jit_offset(&SR));
+    jit->load64(Jit::EBP, jit_offset(&clock_cycles));
+}
+
+// Leave with PC = next when al (a helper's bool result) is set.
+void CPU::jit_bail_if_al(Word next)
+{
+    Jit &j = *jit;
+    j.zero_extend8(Jit::EAX, Jit::EAX);
+    j.op_rr(X86_TEST, Jit::EAX, Jit::EAX);
+    Byte *stay = j.jcc(Jit::EQUAL);
+    j.mov_ri(Jit::EAX, next);
+    j.bind(j.jmp(), j.leave_from_eax);
+    j.bind(stay, j.here());
+}
+
+// N and Z from the byte in value; clobbers ecx.
+void CPU::jit_nz(int value)
+{
+    Jit &j = *jit;
+    j.alu_ri(Jit::AND, REG_SR, ~(NEGATIVE | ZERO));
+    j.op_rr(X86_MOV, Jit::ECX, value);
+    j.alu_ri(Jit::AND, Jit::ECX, NEGATIVE);
+    j.op_rr(X86_OR, REG_SR, Jit::ECX);
+    j.op_rr(X86_TEST, value, value);
+    j.setcc(Jit::EQUAL, Jit::ECX);
+    j.op_rr(X86_ADD, Jit::ECX, Jit::ECX); // ZERO is bit 1
+    j.op_rr(X86_OR, REG_SR, Jit::ECX);
+}
+
+// +1 cycle (in rbp) when the 16-bit address in reg is on a different page
+// than base; clobbers ecx.
+void CPU::jit_page_penalty(int address, int base)
+{
+    Jit &j = *jit;
+    j.op_rr(X86_MOV, Jit::ECX, address);
+    j.op_rr(X86_XOR, Jit::ECX, base);
+    j.alu_ri(Jit::AND, Jit::ECX, 0xFF00);
+    j.setcc(Jit::NOT_EQUAL, Jit::ECX);
+    j.add_cycles_reg(Jit::ECX);
+}
+
+// Effective address of a memory operand into esi.
+void CPU::jit_address(int mode_id, Word operand, bool penalty)
+{
+    Jit &j = *jit;
+    jit_mode m = static_cast<jit_mode>(mode_id);
+    switch (m)
+    {
+    case jit_mode::zeropageX:
+    case jit_mode::zeropageY:
+        j.op_rr(X86_MOV, Jit::ESI, m == jit_mode::zeropageX ? REG_X : REG_Y);
+        j.alu_ri(Jit::ADD, Jit::ESI, operand);
+        j.alu_ri(Jit::AND, Jit::ESI, 0xFF);
+        break;
+    case jit_mode::absoluteX:
+    case jit_mode::absoluteY:
+        j.op_rr(X86_MOV, Jit::ESI, m == jit_mode::absoluteX ? REG_X : REG_Y);
+        j.alu_ri(Jit::ADD, Jit::ESI, operand);
+        j.alu_ri(Jit::AND, Jit::ESI, 0xFFFF);
+        if (penalty)
+        {
+            j.mov_ri(Jit::EDX, operand);
+            jit_page_penalty(Jit::ESI, Jit::EDX);
+        }
+        break;
+    case jit_mode::indirectX:
+        j.op_rr(X86_MOV, Jit::ESI, REG_X);
+        j.alu_ri(Jit::ADD, Jit::ESI, operand);
+        j.alu_ri(Jit::AND, Jit::ESI, 0xFF);
+        j.mov_rr64(Jit::EDI, Jit::EBX);
+        j.call(reinterpret_cast<const void *>(&CPU::jit_pointer));
+        j.zero_extend16(Jit::ESI, Jit::EAX);
+        break;
+    case jit_mode::indirectY:
+        j.mov_ri(Jit::ESI, operand);
+        j.mov_rr64(Jit::EDI, Jit::EBX);
+        j.call(reinterpret_cast<const void *>(&CPU::jit_pointer));
+        j.zero_extend16(Jit::EAX, Jit::EAX);
+        j.op_rr(X86_MOV, Jit::ESI, Jit::EAX);
+        j.op_rr(X86_ADD, Jit::ESI, REG_Y);
+        j.alu_ri(Jit::AND, Jit::ESI, 0xFFFF);
+        if (penalty)
+        {
+            jit_page_penalty(Jit::ESI, Jit::EAX);
+        }
+        break;
+    default: // zeropage, absolute
+        j.mov_ri(Jit::ESI, operand);
+        break;
+    }
+}
+
+// Operand value of a load into eax.
+void CPU::jit_load(int mode_id, Word operand)
+{
+    Jit &j = *jit;
+    if (static_cast<jit_mode>(mode_id) == jit_mode::immediate)
+    {
+        j.mov_ri(Jit::EAX, operand & 0xFF);
+        return;
+    }
+    jit_address(mode_id, operand, true);
+    j.mov_rr64(Jit::EDI, Jit::EBX);
+    j.call(reinterpret_cast<const void *>(&CPU::jit_read));
+    j.zero_extend8(Jit::EAX, Jit::EAX);
+}
+
+void CPU::jit_store(int mode_id, Word operand, int reg, Word next)
+{
+    Jit &j = *jit;
+    jit_address(mode_id, operand, false);
+    j.op_rr(X86_MOV, Jit::EDX, reg);
+    j.mov_rr64(Jit::EDI, Jit::EBX);
+    j.call(reinterpret_cast<const void *>(&CPU::jit_write));
+    jit_bail_if_al(next);
+}
+
+bool CPU::jit_emit(const DecodedOp &d)
+{
+    Jit &j = *jit;
+    const jit_info &info = jit_table[d.opcode];
+    int m = static_cast<int>(info.mode);
+
+    // cycles are additive, so charge the base count up front
+    j.add_cycles(d.cycles);
+
+    if (!info.implemented)
+    {
+        return false;
+    }
+
+    switch (info.op)
+    {
+    case jit_op::LDA:
+    case jit_op::LDX:
+    case jit_op::LDY:
+    {
+        int reg = info.op == jit_op::LDA ? REG_A : info.op == jit_op::LDX ? REG_X : REG_Y;
+        jit_load(m, d.operand);
+        j.op_rr(X86_MOV, reg, Jit::EAX);
+        jit_nz(reg);
+        return true;
+    }
+    case jit_op::STA:
+        jit_store(m, d.operand, REG_A, d.next);
+        return true;
+    case jit_op::STX:
+        jit_store(m, d.operand, REG_X, d.next);
+        return true;
+    case jit_op::STY:
+        jit_store(m, d.operand, REG_Y, d.next);
+        return true;
+    case jit_op::TAX:
+    case jit_op::TAY:
+    case jit_op::TXA:
+    case jit_op::TYA:
+    {
+        int from = (info.op == jit_op::TAX || info.op == jit_op::TAY) ? REG_A
+                   : info.op == jit_op::TXA                           ? REG_X
+                                                                      : REG_Y;
+        int to = info.op == jit_op::TAX ? REG_X : info.op == jit_op::TAY ? REG_Y : REG_A;
+        j.op_rr(X86_MOV, to, from);
+        jit_nz(to);
+        return true;
+    }
+    case jit_op::TSX:
+        j.load8(REG_X, jit_offset(&SP));
+        jit_nz(REG_X);
+        return true;
+    case jit_op::TXS:
+        j.store8(jit_offset(&SP), REG_X);
+        return true;
+    case jit_op::INX:
+    case jit_op::INY:
+    case jit_op::DEX:
+    case jit_op::DEY:
+    {
+        int reg = (info.op == jit_op::INX || info.op == jit_op::DEX) ? REG_X : REG_Y;
+        bool up = info.op == jit_op::INX || info.op == jit_op::INY;
+        j.alu_ri(up ? Jit::ADD : Jit::SUB, reg, 1);
+        j.alu_ri(Jit::AND, reg, 0xFF);
+        jit_nz(reg);
+        return true;
+    }
+    case jit_op::INC:
+    case jit_op::DEC:
+        jit_address(m, d.operand, false);
+        j.store_stack32(SCRATCH_SLOT, Jit::ESI);
+        j.mov_rr64(Jit::EDI, Jit::EBX);
+        j.call(reinterpret_cast<const void *>(&CPU::jit_read));
+        j.zero_extend8(Jit::EAX, Jit::EAX);
+        j.alu_ri(info.op == jit_op::INC ? Jit::ADD : Jit::SUB, Jit::EAX, 1);
+        j.alu_ri(Jit::AND, Jit::EAX, 0xFF);
+        jit_nz(Jit::EAX);
+        j.op_rr(X86_MOV, Jit::EDX, Jit::EAX);
+        j.load_stack32(Jit::ESI, SCRATCH_SLOT);
+        j.mov_rr64(Jit::EDI, Jit::EBX);
+        j.call(reinterpret_cast<const void *>(&CPU::jit_write));
+        jit_bail_if_al(d.next);
+        return true;
+    case jit_op::AND:
+    case jit_op::ORA:
+    case jit_op::EOR:
+        jit_load(m, d.operand);
+        j.op_rr(info.op == jit_op::AND ? X86_AND : info.op == jit_op::ORA ? X86_OR : X86_XOR, REG_A, Jit::EAX);
+        jit_nz(REG_A);
+        return true;
+    case jit_op::CMP:
+    case jit_op::CPX:
+    case jit_op::CPY:
+    {
+        int reg = info.op == jit_op::CMP ? REG_A : info.op == jit_op::CPX ? REG_X : REG_Y;
+        jit_load(m, d.operand);
+        j.op_rr(X86_CMP, reg, Jit::EAX);
+        j.setcc(Jit::ABOVE_EQUAL, Jit::ECX);
+        j.alu_ri(Jit::AND, REG_SR, ~CARRY);
+        j.op_rr(X86_OR, REG_SR, Jit::ECX);
+        j.op_rr(X86_MOV, Jit::EDX, reg);
+        j.op_rr(X86_SUB, Jit::EDX, Jit::EAX);
+        j.alu_ri(Jit::AND, Jit::EDX, 0xFF);
+        jit_nz(Jit::EDX);
+        return true;
+    }
+    case jit_op::CLC:
+    case jit_op::CLD:
+    case jit_op::CLI:
+    case jit_op::CLV:
+    {
+        flags f = info.op == jit_op::CLC ? CARRY : info.op == jit_op::CLD ? DECIMAL : info.op == jit_op::CLI ? INTERRUPT : OVERFLOW;
+        j.alu_ri(Jit::AND, REG_SR, ~f);
+        return true;
+    }
+    case jit_op::SEC:
+    case jit_op::SED:
+    case jit_op::SEI:
+    {
+        flags f = info.op == jit_op::SEC ? CARRY : info.op == jit_op::SED ? DECIMAL : INTERRUPT;
+        j.alu_ri(Jit::OR, REG_SR, f);
+        return true;
+    }
+    case jit_op::BCC:
+    case jit_op::BCS:
+    case jit_op::BEQ:
+    case jit_op::BNE:
+    case jit_op::BMI:
+    case jit_op::BPL:
+    case jit_op::BVC:
+    case jit_op::BVS:
+    {
+        flags f = (info.op == jit_op::BCC || info.op == jit_op::BCS)   ? CARRY
+                  : (info.op == jit_op::BEQ || info.op == jit_op::BNE) ? ZERO
+                  : (info.op == jit_op::BMI || info.op == jit_op::BPL) ? NEGATIVE
+                                                                       : OVERFLOW;
+        bool when_set = info.op == jit_op::BCS || info.op == jit_op::BEQ ||
+                        info.op == jit_op::BMI || info.op == jit_op::BVS;
+        Word target = d.next + static_cast<std::int8_t>(d.operand);
+
+        j.test_ri(REG_SR, f);
+        Byte *not_taken = j.jcc(when_set ? Jit::EQUAL : Jit::NOT_EQUAL);
+        j.add_cycles(((d.next ^ target) & 0xFF00) ? 2 : 1);
+        j.exit_to(target);
+        j.bind(not_taken, j.here());
+        j.exit_to(d.next);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void CPU::jit_emit_fallback(const DecodedOp &d)
+{
+    Jit &j = *jit;
+    jit_spill();
+    j.mov_rr64(Jit::EDI, Jit::EBX);
+    j.mov_ri64(Jit::ESI, reinterpret_cast<std::uint64_t>(d.handler));
+    j.mov_ri(Jit::EDX, d.operand);
+    j.mov_ri(Jit::ECX, d.next);
+    j.call(reinterpret_cast<const void *>(&CPU::jit_fallback));
+    j.store_stack32(SCRATCH_SLOT, Jit::EAX);
+    jit_reload();
+
+    // halted or invalidated: leave with whatever PC the handler set
+    j.load_stack32(Jit::EAX, SCRATCH_SLOT);
+    j.zero_extend8(Jit::EAX, Jit::EAX);
+    j.op_rr(X86_TEST, Jit::EAX, Jit::EAX);
+    Byte *stay = j.jcc(Jit::EQUAL);
+    j.load16(Jit::EAX, jit_offset(&PC));
+    j.bind(j.jmp(), j.leave_from_eax);
+    j.bind(stay, j.here());
+}
+
+void *CPU::jit_translate(Word pc)
+{
+    const Block *block = cache->find(pc);
+    if (block == nullptr)
+    {
+        block = &cache->insert(decode_block(pc));
+    }
+
+    Jit &j = *jit;
+    j.open();
+    Byte *body = j.here();
+    bool ended = false;
+    for (const DecodedOp &d : block->ops)
+    {
+        if (!jit_emit(d))
+        {
+            // jit_emit has only charged the cycles when it gives up
+            jit_emit_fallback(d);
+        }
+
+        ended = jit_table[d.opcode].mode == jit_mode::relative;
+        if (!ended && &d != &block->ops.back())
+        {
+            // stop between instructions once the budget is spent
+            j.cmp_cycles_limit();
+            Byte *more = j.jcc(Jit::BELOW);
+            j.mov_ri(Jit::EAX, d.next);
+            j.bind(j.jmp(), j.leave_from_eax);
+            j.bind(more, j.here());
+        }
+    }
+    if (!ended)
+    {
+        j.exit_to(block->ops.back().next);
+    }
+    j.add_block(pc, body);
+    j.close();
+    return body;
+}
+
+//** Dispatch Loop **//
+
+void CPU::run_jit(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    auto enter = reinterpret_cast<void (*)(CPU *, std::uint64_t, void *)>(jit->enter_trampoline);
+
+    while (!interrupt && clock_cycles < cycle_limit && PC != stop_at)
+    {
+        if (cache->generation() != jit_generation)
+        {
+            // chained exits may point into the dropped blocks
+            jit->flush();
+            jit_generation = cache->generation();
+        }
+
+        // run_until needs a check between every instruction, which only the
+        // interpreter makes
+        if (stop_at < 0 && jit->available())
+        {
+            void *native = jit->lookup(PC);
+            if (native == nullptr && jit->heat(PC) > jit_threshold)
+            {
+                native = jit_translate(PC);
+                jit_generation = cache->generation();
+            }
+            if (native != nullptr)
+            {
+                jit->stats.native_entries++;
+                enter(this, cycle_limit, native);
+                continue;
+            }
+        }
+
+        const Block *block = cache->find(PC);
+        if (block == nullptr)
+        {
+            block = &cache->insert(decode_block(PC));
+        }
+        run_block(*block, cycle_limit, stop_at);
+    }
+}
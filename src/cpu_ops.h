@@ -0,0 +1,926 @@
+#ifndef CPU_OPS_H
+#define CPU_OPS_H
+
+#include <array>
+#include <cstdint>
+
+#include "cpu.h"
+
+// Policy types for the fused engines. Every opcode is an (op, mode) pair,
+// and BasicCPU::execute<op, mode, cycles>() stamps out one inlined function per
+// opcode. The mode decides how the operand is fetched and where it points
+// (including the page-cross penalty for indexed reads); the op only ever
+// sees load/store/modify, so neither side branches on the opcode at runtime.
+// Helpers touch SR directly so nothing here depends on out-of-line calls.
+// With LAZY_NZ (the LAZY engine), results only record the byte N and Z
+// come from, in nz, and SR's N/Z bits are stale until materialize_flags().
+// DEAD_NZ and DEAD_CV leave those flags out altogether, for instructions the
+// block liveness pass found overwriting them before anything looks.
+
+#if defined(__GNUC__)
+#define CPU_FLATTEN __attribute__((flatten))
+#else
+#define CPU_FLATTEN
+#endif
+
+//** Decimal Mode **//
+
+// ADC and SBC with D set, as an NMOS 6502 does them: a BCD digit at a time
+// from a 512-byte table per operation, so neither needs a branch on the
+// digits. Operands that are not valid BCD give what the chip gives.
+namespace decimal
+{
+    // Entry at carry << 8 | digit of A << 4 | digit of the operand: bits
+    // 0-3 are the result digit and bit 4 the carry out (for SBC, no borrow).
+    // For ADC, bits 7 and 6 are the N and V the high digit produces before
+    // it is adjusted, which is where the chip takes them from.
+    constexpr std::array<Byte, 512> digits(bool subtract)
+    {
+        std::array<Byte, 512> t{};
+        for (int carry = 0; carry < 2; carry++)
+        {
+            for (int a = 0; a < 16; a++)
+            {
+                for (int b = 0; b < 16; b++)
+                {
+                    int entry = 0;
+                    if (subtract)
+                    {
+                        int raw = a - b - (1 - carry);
+                        bool borrow = raw < 0;
+                        entry = ((raw - (borrow ? 6 : 0)) & 0x0F) | (borrow ? 0x00 : 0x10);
+                    }
+                    else
+                    {
+                        int raw = a + b + carry;
+                        int adjusted = raw > 9 ? raw + 6 : raw;
+                        entry = (adjusted & 0x0F) | (adjusted > 0x0F ? 0x10 : 0x00) |
+                                ((raw & 0x08) << 4) | ((~(a ^ b) & (a ^ raw) & 0x08) << 3);
+                    }
+                    t[carry << 8 | a << 4 | b] = entry;
+                }
+            }
+        }
+        return t;
+    }
+
+    inline constexpr std::array<Byte, 512> add_digits = digits(false);
+    inline constexpr std::array<Byte, 512> subtract_digits = digits(true);
+
+    // result in the low byte; N, V and C (as in SR) in the high byte
+    inline Word add(Byte a, Byte b, unsigned carry)
+    {
+        Byte low = add_digits[carry << 8 | (a & 0x0F) << 4 | (b & 0x0F)];
+        Byte high = add_digits[(low & 0x10) << 4 | (a & 0xF0) | b >> 4];
+        Byte flags = (high & 0xC0) | (high >> 4 & 0x01);
+        return (flags << 8) | (high << 4 & 0xF0) | (low & 0x0F);
+    }
+
+    inline Byte subtract(Byte a, Byte b, unsigned carry)
+    {
+        Byte low = subtract_digits[carry << 8 | (a & 0x0F) << 4 | (b & 0x0F)];
+        Byte high = subtract_digits[(low & 0x10) << 4 | (a & 0xF0) | b >> 4];
+        return (high << 4 & 0xF0) | (low & 0x0F);
+    }
+}
+
+//** Shared Helpers **//
+
+template <class Bus>
+inline Byte BasicCPU<Bus>::fetch()
+{
+    return memory->read(PC++);
+}
+
+template <class Bus>
+inline Word BasicCPU<Bus>::fetch_word()
+{
+    Word word = memory->read_word(PC);
+    PC += 2;
+    return word;
+}
+
+template <class Bus>
+template <int Length>
+inline Word BasicCPU<Bus>::fetch_operand()
+{
+    if constexpr (Length == 2)
+    {
+        return fetch_word();
+    }
+    else if constexpr (Length == 1)
+    {
+        return fetch();
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+template <class Bus>
+inline Word BasicCPU<Bus>::zeropage_word(Byte address)
+{
+    if (address != 0xFF)
+    {
+        return memory->read_word(address);
+    }
+    // the high byte wraps back to $00, not on to $0100
+    return memory->read(0x00FF) | (memory->read(0x0000) << 8);
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::page_cross(Word base, Word address)
+{
+    if ((base ^ address) & 0xFF00)
+    {
+        clock_cycles++;
+    }
+}
+
+template <class Bus>
+template <Byte Flags>
+inline Byte BasicCPU<Bus>::transfer(Byte data)
+{
+    assign_nz<Flags>(data, data);
+    return data;
+}
+
+template <class Bus>
+template <Byte Flags>
+inline void BasicCPU<Bus>::assign_nz(Byte negative, Byte zero)
+{
+    if constexpr (Flags & DEAD_NZ)
+    {
+        return;
+    }
+    else if constexpr (Flags & LAZY_NZ)
+    {
+        nz = (negative << 8) | zero; // one store; N and Z are worked out if anything asks
+    }
+    else
+    {
+        SR = (SR & ~(NEGATIVE | ZERO)) | (negative & NEGATIVE) | (zero == 0 ? ZERO : 0);
+    }
+}
+
+template <class Bus>
+template <Byte Flags>
+inline bool BasicCPU<Bus>::test(flags f) const
+{
+    if constexpr (Flags & LAZY_NZ)
+    {
+        if (f == NEGATIVE)
+        {
+            return nz & 0x8000;
+        }
+        if (f == ZERO)
+        {
+            return (nz & 0x00FF) == 0;
+        }
+    }
+    return SR & f;
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::materialize_flags()
+{
+    SR = (SR & ~(NEGATIVE | ZERO)) | ((nz >> 8) & NEGATIVE) | ((nz & 0x00FF) == 0 ? ZERO : 0);
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::defer_flags()
+{
+    // N and Z may both be set (by PLP or setSR), which no single result
+    // byte gives, hence the separate N bit
+    nz = ((SR & NEGATIVE) << 8) | ((SR & ZERO) ? 0x00 : 0x01);
+}
+
+template <class Bus>
+template <Byte Flags>
+inline void BasicCPU<Bus>::assign_cv(Byte flags)
+{
+    if constexpr (!(Flags & DEAD_CV))
+    {
+        SR = (SR & ~(CARRY | OVERFLOW)) | flags;
+    }
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::assign(flags f, bool value)
+{
+    SR = value ? (SR | f) : (SR & ~f);
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::push(Byte data)
+{
+    memory->write(0x0100 | SP, data);
+    SP--;
+}
+
+template <class Bus>
+inline Byte BasicCPU<Bus>::pull()
+{
+    // matches PLA/PLP: read the current top, then move SP
+    Byte data = memory->read(0x0100 | SP);
+    SP++;
+    return data;
+}
+
+template <class Bus>
+template <Byte Flags>
+inline void BasicCPU<Bus>::add(Byte data)
+{
+    unsigned carry = SR & CARRY;
+    unsigned sum = A + data + carry;
+    Byte result = sum;
+    Byte flags = (sum >> 8) | (((A ^ sum) & (data ^ sum) & 0x80) >> 1); // C and V
+    Byte negative = sum;
+    if (SR & DECIMAL)
+    {
+        Word bcd = decimal::add(A, data, carry);
+        result = bcd;
+        flags = (bcd >> 8) & (CARRY | OVERFLOW);
+        negative = bcd >> 8;
+    }
+    assign_cv<Flags>(flags);
+    A = result;
+    assign_nz<Flags>(negative, sum); // Z follows the binary sum even in decimal mode
+}
+
+template <class Bus>
+template <Byte Flags>
+inline void BasicCPU<Bus>::subtract(Byte data)
+{
+    // the flags are always those of the binary A + ~data + C
+    unsigned carry = SR & CARRY;
+    unsigned inverted = data ^ 0xFF;
+    unsigned sum = A + inverted + carry;
+    Byte flags = (sum >> 8) | (((A ^ sum) & (inverted ^ sum) & 0x80) >> 1);
+    assign_cv<Flags>(flags);
+    assign_nz<Flags>(sum, sum);
+    A = (SR & DECIMAL) ? decimal::subtract(A, data, carry) : Byte(sum);
+}
+
+template <class Bus>
+template <Byte Flags>
+inline Byte BasicCPU<Bus>::shift_left(Byte data)
+{
+    assign_cv<Flags>((data >> 7) | (SR & OVERFLOW));
+    return transfer<Flags>(data << 1);
+}
+
+template <class Bus>
+template <Byte Flags>
+inline Byte BasicCPU<Bus>::shift_right(Byte data)
+{
+    assign_cv<Flags>((data & CARRY) | (SR & OVERFLOW));
+    return transfer<Flags>(data >> 1);
+}
+
+template <class Bus>
+template <Byte Flags>
+inline void BasicCPU<Bus>::compare(Byte reg, Byte data)
+{
+    assign_cv<Flags>((reg >= data) | (SR & OVERFLOW));
+    transfer<Flags>(reg - data);
+}
+
+template <class Bus>
+inline void BasicCPU<Bus>::branch_to(bool condition, Byte offset)
+{
+    if (condition)
+    {
+        // offset is signed and relative to the following instruction
+        Word target = PC + static_cast<std::int8_t>(offset);
+        if ((PC & 0xFF00) != (target & 0xFF00))
+        {
+            clock_cycles++;
+        }
+        PC = target;
+        clock_cycles++;
+    }
+}
+
+//** Addressing Mode Policies **//
+
+template <class Bus>
+struct BasicCPU<Bus>::mode
+{
+    // Memory operands: the derived mode supplies address<Penalty>(), and
+    // only loads ask for the page-cross cycle. Each mode's reach says which
+    // pages its operand can touch: 0 none, 1 the operand's own, 2 that and
+    // the next (indexed), 3 any (through a pointer).
+    template <class Mode>
+    struct memory_operand
+    {
+        static Byte load(BasicCPU &cpu, Word operand)
+        {
+            return cpu.memory->read(Mode::template address<true>(cpu, operand));
+        }
+
+        static void store(BasicCPU &cpu, Word operand, Byte data)
+        {
+            cpu.memory->write(Mode::template address<false>(cpu, operand), data);
+        }
+
+        template <class F>
+        static void modify(BasicCPU &cpu, Word operand, F f)
+        {
+            Word address = Mode::template address<false>(cpu, operand);
+            cpu.memory->write(address, f(cpu.memory->read(address)));
+        }
+    };
+
+    struct implied
+    {
+        static constexpr int length = 0;
+        static constexpr int reach = 0;
+    };
+
+    struct accumulator
+    {
+        static constexpr int length = 0;
+        static constexpr int reach = 0;
+
+        template <class F>
+        static void modify(BasicCPU &cpu, Word, F f)
+        {
+            cpu.A = f(cpu.A);
+        }
+    };
+
+    struct immediate
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 0;
+
+        static Byte load(BasicCPU &, Word operand)
+        {
+            return operand;
+        }
+    };
+
+    struct relative
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 0;
+    };
+
+    struct zeropage : memory_operand<zeropage>
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 1;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &, Word operand)
+        {
+            return operand;
+        }
+    };
+
+    struct zeropageX : memory_operand<zeropageX>
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 1;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            // indexing wraps around inside the zero page
+            return (Byte)(operand + cpu.X);
+        }
+    };
+
+    struct zeropageY : memory_operand<zeropageY>
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 1;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            return (Byte)(operand + cpu.Y);
+        }
+    };
+
+    struct absolute : memory_operand<absolute>
+    {
+        static constexpr int length = 2;
+        static constexpr int reach = 1;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &, Word operand)
+        {
+            return operand;
+        }
+    };
+
+    struct absoluteX : memory_operand<absoluteX>
+    {
+        static constexpr int length = 2;
+        static constexpr int reach = 2;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            Word address = operand + cpu.X;
+            if (Penalty)
+            {
+                cpu.page_cross(operand, address);
+            }
+            return address;
+        }
+    };
+
+    struct absoluteY : memory_operand<absoluteY>
+    {
+        static constexpr int length = 2;
+        static constexpr int reach = 2;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            Word address = operand + cpu.Y;
+            if (Penalty)
+            {
+                cpu.page_cross(operand, address);
+            }
+            return address;
+        }
+    };
+
+    struct indirectX : memory_operand<indirectX>
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 3;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            return cpu.zeropage_word((Byte)(operand + cpu.X));
+        }
+    };
+
+    struct indirectY : memory_operand<indirectY>
+    {
+        static constexpr int length = 1;
+        static constexpr int reach = 3;
+
+        template <bool Penalty>
+        static Word address(BasicCPU &cpu, Word operand)
+        {
+            Word base = cpu.zeropage_word(operand);
+            Word address = base + cpu.Y;
+            if (Penalty)
+            {
+                cpu.page_cross(base, address);
+            }
+            return address;
+        }
+    };
+};
+
+//** Operation Policies **//
+
+template <class Bus>
+struct BasicCPU<Bus>::op
+{
+    // What an operation does with SR, for the block liveness pass: the
+    // flags it reads and writes, and whether it may store (ASL and LSR only
+    // when their mode is not the accumulator).
+    template <Byte Reads, Byte Writes, bool Stores = false>
+    struct effects
+    {
+        static constexpr Byte reads = Reads;
+        static constexpr Byte writes = Writes;
+        static constexpr bool stores = Stores;
+    };
+
+    // Generic shapes; the mnemonics below are instances of these.
+
+    template <Byte BasicCPU::*Reg>
+    struct load : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.*Reg = cpu.template transfer<Flags>(M::load(cpu, operand));
+        }
+    };
+
+    template <Byte BasicCPU::*Reg>
+    struct store : effects<0, 0, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            M::store(cpu, operand, cpu.*Reg);
+        }
+    };
+
+    template <Byte BasicCPU::*From, Byte BasicCPU::*To>
+    struct transfer : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.*To = cpu.template transfer<Flags>(cpu.*From);
+        }
+    };
+
+    template <Byte BasicCPU::*Reg, Byte Delta>
+    struct step_register : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.*Reg = cpu.template transfer<Flags>(cpu.*Reg + Delta);
+        }
+    };
+
+    template <Byte Delta>
+    struct step_memory : effects<0, NEGATIVE | ZERO, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            M::modify(cpu, operand, [&cpu](Byte data) { return cpu.template transfer<Flags>(data + Delta); });
+        }
+    };
+
+    template <Byte BasicCPU::*Reg>
+    struct compare : effects<0, NEGATIVE | ZERO | CARRY>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.template compare<Flags>(cpu.*Reg, M::load(cpu, operand));
+        }
+    };
+
+    template <flags F, bool Value>
+    struct set_flag : effects<0, F>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            if constexpr (!(Flags & DEAD_CV) || !(F & (CARRY | OVERFLOW)))
+            {
+                cpu.assign(F, Value);
+            }
+        }
+    };
+
+    template <flags F, bool Value>
+    struct branch : effects<F, 0>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.branch_to(cpu.template test<Flags>(F) == Value, operand);
+        }
+    };
+
+    struct BRK : effects<0, 0>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.interrupt = true;
+        }
+    };
+
+    using LDA = load<&BasicCPU::A>;
+    using LDX = load<&BasicCPU::X>;
+    using LDY = load<&BasicCPU::Y>;
+    using STA = store<&BasicCPU::A>;
+    using STX = store<&BasicCPU::X>;
+    using STY = store<&BasicCPU::Y>;
+    using TAX = transfer<&BasicCPU::A, &BasicCPU::X>;
+    using TAY = transfer<&BasicCPU::A, &BasicCPU::Y>;
+    using TSX = transfer<&BasicCPU::SP, &BasicCPU::X>;
+    using TXA = transfer<&BasicCPU::X, &BasicCPU::A>;
+    using TYA = transfer<&BasicCPU::Y, &BasicCPU::A>;
+
+    struct TXS : effects<0, 0>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.SP = cpu.X;
+        }
+    };
+
+    struct PHA : effects<0, 0, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.push(cpu.A);
+        }
+    };
+
+    struct PHP : effects<0xFF, 0, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            if (Flags & LAZY_NZ)
+            {
+                cpu.materialize_flags();
+            }
+            cpu.push(cpu.SR);
+            cpu.SR |= BREAK | IGNORED;
+        }
+    };
+
+    struct PLA : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.A = cpu.template transfer<Flags>(cpu.pull());
+        }
+    };
+
+    struct PLP : effects<0, 0xFF>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word)
+        {
+            cpu.SR = cpu.pull();
+            if (Flags & LAZY_NZ)
+            {
+                cpu.defer_flags();
+            }
+        }
+    };
+
+    using DEC = step_memory<0xFF>;
+    using INC = step_memory<0x01>;
+    using DEX = step_register<&BasicCPU::X, 0xFF>;
+    using DEY = step_register<&BasicCPU::Y, 0xFF>;
+    using INX = step_register<&BasicCPU::X, 0x01>;
+    using INY = step_register<&BasicCPU::Y, 0x01>;
+
+    struct ADC : effects<CARRY | DECIMAL, NEGATIVE | ZERO | CARRY | OVERFLOW>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.template add<Flags>(M::load(cpu, operand));
+        }
+    };
+
+    struct SBC : effects<CARRY | DECIMAL, NEGATIVE | ZERO | CARRY | OVERFLOW>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.template subtract<Flags>(M::load(cpu, operand));
+        }
+    };
+
+    struct AND : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.A = cpu.template transfer<Flags>(cpu.A & M::load(cpu, operand));
+        }
+    };
+
+    struct EOR : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.A = cpu.template transfer<Flags>(cpu.A ^ M::load(cpu, operand));
+        }
+    };
+
+    struct ORA : effects<0, NEGATIVE | ZERO>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            cpu.A = cpu.template transfer<Flags>(cpu.A | M::load(cpu, operand));
+        }
+    };
+
+    struct ASL : effects<0, NEGATIVE | ZERO | CARRY, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            M::modify(cpu, operand, [&cpu](Byte data) { return cpu.template shift_left<Flags>(data); });
+        }
+    };
+
+    struct LSR : effects<0, NEGATIVE | ZERO | CARRY, true>
+    {
+        template <class M, Byte Flags = EAGER_FLAGS>
+        static void apply(BasicCPU &cpu, Word operand)
+        {
+            M::modify(cpu, operand, [&cpu](Byte data) { return cpu.template shift_right<Flags>(data); });
+        }
+    };
+
+    using CLC = set_flag<CARRY, false>;
+    using CLD = set_flag<DECIMAL, false>;
+    using CLI = set_flag<INTERRUPT, false>;
+    using CLV = set_flag<OVERFLOW, false>;
+    using SEC = set_flag<CARRY, true>;
+    using SED = set_flag<DECIMAL, true>;
+    using SEI = set_flag<INTERRUPT, true>;
+
+    using CMP = compare<&BasicCPU::A>;
+    using CPX = compare<&BasicCPU::X>;
+    using CPY = compare<&BasicCPU::Y>;
+
+    using BCC = branch<CARRY, false>;
+    using BCS = branch<CARRY, true>;
+    using BEQ = branch<ZERO, true>;
+    using BMI = branch<NEGATIVE, true>;
+    using BNE = branch<ZERO, false>;
+    using BPL = branch<NEGATIVE, false>;
+    using BVC = branch<OVERFLOW, false>;
+    using BVS = branch<OVERFLOW, true>;
+};
+
+//** Opcode Map **//
+
+// Every implemented opcode as X(opcode, op, mode, base cycles). The fused
+// engines expand this list instead of keeping their own copies.
+#define CPU_OPCODES(X) \
+    X(0x00, BRK, implied, 7) \
+    /* LDA OPCODES */ \
+    X(0xA9, LDA, immediate, 2) \
+    X(0xA5, LDA, zeropage, 3) \
+    X(0xB5, LDA, zeropageX, 4) \
+    X(0xAD, LDA, absolute, 4) \
+    X(0xBD, LDA, absoluteX, 4) \
+    X(0xB9, LDA, absoluteY, 4) \
+    X(0xA1, LDA, indirectX, 6) \
+    X(0xB1, LDA, indirectY, 5) \
+    /* LDX OPCODES */ \
+    X(0xA2, LDX, immediate, 2) \
+    X(0xA6, LDX, zeropage, 3) \
+    X(0xB6, LDX, zeropageY, 4) \
+    X(0xAE, LDX, absolute, 4) \
+    X(0xBE, LDX, absoluteY, 4) \
+    /* LDY OPCODES */ \
+    X(0xA0, LDY, immediate, 2) \
+    X(0xA4, LDY, zeropage, 3) \
+    X(0xB4, LDY, zeropageX, 4) \
+    X(0xAC, LDY, absolute, 4) \
+    X(0xBC, LDY, absoluteX, 4) \
+    /* STA OPCODES */ \
+    X(0x85, STA, zeropage, 3) \
+    X(0x95, STA, zeropageX, 4) \
+    X(0x8D, STA, absolute, 4) \
+    X(0x9D, STA, absoluteX, 5) \
+    X(0x99, STA, absoluteY, 5) \
+    X(0x81, STA, indirectX, 6) \
+    X(0x91, STA, indirectY, 6) \
+    /* STX OPCODES */ \
+    X(0x86, STX, zeropage, 3) \
+    X(0x96, STX, zeropageY, 4) \
+    X(0x8E, STX, absolute, 4) \
+    /* STY OPCODES */ \
+    X(0x84, STY, zeropage, 3) \
+    X(0x94, STY, zeropageX, 4) \
+    X(0x8C, STY, absolute, 4) \
+    /* T__ OPCODES */ \
+    X(0xAA, TAX, implied, 2) \
+    X(0xA8, TAY, implied, 2) \
+    X(0xBA, TSX, implied, 2) \
+    X(0x8A, TXA, implied, 2) \
+    X(0x9A, TXS, implied, 2) \
+    X(0x98, TYA, implied, 2) \
+    /* Stack OPCODES */ \
+    X(0x48, PHA, implied, 3) \
+    X(0x08, PHP, implied, 3) \
+    X(0x68, PLA, implied, 4) \
+    X(0x28, PLP, implied, 4) \
+    /* Decrements & Increments */ \
+    X(0xC6, DEC, zeropage, 5) \
+    X(0xD6, DEC, zeropageX, 6) \
+    X(0xCE, DEC, absolute, 6) \
+    X(0xDE, DEC, absoluteX, 7) \
+    X(0xCA, DEX, implied, 2) \
+    X(0x88, DEY, implied, 2) \
+    X(0xE6, INC, zeropage, 5) \
+    X(0xF6, INC, zeropageX, 6) \
+    X(0xEE, INC, absolute, 6) \
+    X(0xFE, INC, absoluteX, 7) \
+    X(0xE8, INX, implied, 2) \
+    X(0xC8, INY, implied, 2) \
+    /* Arithmetic Operations */ \
+    X(0x69, ADC, immediate, 2) \
+    X(0x65, ADC, zeropage, 3) \
+    X(0x75, ADC, zeropageX, 4) \
+    X(0x6D, ADC, absolute, 4) \
+    X(0x7D, ADC, absoluteX, 4) \
+    X(0x79, ADC, absoluteY, 4) \
+    X(0x61, ADC, indirectX, 6) \
+    X(0x71, ADC, indirectY, 5) \
+    X(0xE9, SBC, immediate, 2) \
+    X(0xE5, SBC, zeropage, 3) \
+    X(0xF5, SBC, zeropageX, 4) \
+    X(0xED, SBC, absolute, 4) \
+    X(0xFD, SBC, absoluteX, 4) \
+    X(0xF9, SBC, absoluteY, 4) \
+    X(0xE1, SBC, indirectX, 6) \
+    X(0xF1, SBC, indirectY, 5) \
+    /* Logical Operations */ \
+    X(0x29, AND, immediate, 2) \
+    X(0x25, AND, zeropage, 3) \
+    X(0x35, AND, zeropageX, 4) \
+    X(0x2D, AND, absolute, 4) \
+    X(0x3D, AND, absoluteX, 4) \
+    X(0x39, AND, absoluteY, 4) \
+    X(0x21, AND, indirectX, 6) \
+    X(0x31, AND, indirectY, 5) \
+    X(0x49, EOR, immediate, 2) \
+    X(0x45, EOR, zeropage, 3) \
+    X(0x55, EOR, zeropageX, 4) \
+    X(0x4D, EOR, absolute, 4) \
+    X(0x5D, EOR, absoluteX, 4) \
+    X(0x59, EOR, absoluteY, 4) \
+    X(0x41, EOR, indirectX, 6) \
+    X(0x51, EOR, indirectY, 5) \
+    X(0x09, ORA, immediate, 2) \
+    X(0x05, ORA, zeropage, 3) \
+    X(0x15, ORA, zeropageX, 4) \
+    X(0x0D, ORA, absolute, 4) \
+    X(0x1D, ORA, absoluteX, 4) \
+    X(0x19, ORA, absoluteY, 4) \
+    X(0x01, ORA, indirectX, 6) \
+    X(0x11, ORA, indirectY, 5) \
+    /* Shift & Rotate */ \
+    X(0x0A, ASL, accumulator, 2) \
+    X(0x06, ASL, zeropage, 5) \
+    X(0x16, ASL, zeropageX, 6) \
+    X(0x0E, ASL, absolute, 6) \
+    X(0x1E, ASL, absoluteX, 7) \
+    X(0x4A, LSR, accumulator, 2) \
+    X(0x46, LSR, zeropage, 5) \
+    X(0x56, LSR, zeropageX, 6) \
+    X(0x4E, LSR, absolute, 6) \
+    X(0x5E, LSR, absoluteX, 7) \
+    /* Flag Instructions */ \
+    X(0x18, CLC, implied, 2) \
+    X(0xD8, CLD, implied, 2) \
+    X(0x58, CLI, implied, 2) \
+    X(0xB8, CLV, implied, 2) \
+    X(0x38, SEC, implied, 2) \
+    X(0xF8, SED, implied, 2) \
+    X(0x78, SEI, implied, 2) \
+    /* Comparisons */ \
+    X(0xC9, CMP, immediate, 2) \
+    X(0xC5, CMP, zeropage, 3) \
+    X(0xD5, CMP, zeropageX, 4) \
+    X(0xCD, CMP, absolute, 4) \
+    X(0xDD, CMP, absoluteX, 4) \
+    X(0xD9, CMP, absoluteY, 4) \
+    X(0xC1, CMP, indirectX, 6) \
+    X(0xD1, CMP, indirectY, 5) \
+    X(0xE0, CPX, immediate, 2) \
+    X(0xE4, CPX, zeropage, 3) \
+    X(0xEC, CPX, absolute, 4) \
+    X(0xC0, CPY, immediate, 2) \
+    X(0xC4, CPY, zeropage, 3) \
+    X(0xCC, CPY, absolute, 4) \
+    /* Conditional Branching */ \
+    X(0x90, BCC, relative, 2) \
+    X(0xB0, BCS, relative, 2) \
+    X(0xF0, BEQ, relative, 2) \
+    X(0x30, BMI, relative, 2) \
+    X(0xD0, BNE, relative, 2) \
+    X(0x10, BPL, relative, 2) \
+    X(0x50, BVC, relative, 2) \
+    X(0x70, BVS, relative, 2)
+
+//** Opcode Instantiation **//
+
+template <class Bus>
+template <class Op, class Mode, Byte Cycles, Byte Flags>
+inline void BasicCPU<Bus>::execute()
+{
+    Op::template apply<Mode, Flags>(*this, fetch_operand<Mode::length>());
+    clock_cycles += Cycles;
+}
+
+// The operand was fetched at decode time and PC already points past the
+// instruction; the caller adds the base cycles. The DEAD_NZ and DEAD_CV
+// variants are the ones a block runs when nothing reads those flags.
+template <class Op, class Mode, Byte Flags>
+void CPU::decoded(CPU &cpu, Word operand)
+{
+    Op::template apply<Mode, Flags>(cpu, operand);
+}
+
+#endif // CPU_OPS_H
@@ -0,0 +1,165 @@
+#include "cpu.h"
+#include "cpu_ops.h"
+
+//** BasicCPU **//
+
+template <class Bus>
+BasicCPU<Bus>::BasicCPU(Bus *memory)
+{
+    this->memory = memory;
+    A = X = Y = 0x00;
+    SP = 0xFF;
+    SR = 0x00;
+    PC = 0x0000;
+
+    clock_cycles = 0;
+    interrupt = false;
+    opcode = 0x00;
+    nz = 0x0001;
+}
+
+template <class Bus>
+void BasicCPU<Bus>::reset()
+{
+    memory->reset();
+    reset_registers();
+}
+
+template <class Bus>
+void BasicCPU<Bus>::reset_registers()
+{
+    A = X = Y = 0x00;
+    SP = 0xFF;
+    SR = 0x00;
+    PC = 0x0000;
+
+    clock_cycles = 0;
+    interrupt = false;
+}
+
+template <class Bus>
+void BasicCPU<Bus>::run()
+{
+    dispatch(UINT64_MAX, -1);
+}
+
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::step()
+{
+    // every implemented instruction takes at least one cycle
+    return dispatch(clock_cycles + 1, -1);
+}
+
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::run_for(std::uint64_t cycles)
+{
+    return dispatch(limit_after(cycles), -1);
+}
+
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::run_until(Word address, std::uint64_t max_cycles)
+{
+    return dispatch(limit_after(max_cycles), address);
+}
+
+template <class Bus>
+bool BasicCPU<Bus>::halted() const { return interrupt; }
+
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::dispatch(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    std::uint64_t start = clock_cycles;
+    run_switch(cycle_limit, stop_at);
+    return clock_cycles - start;
+}
+
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::limit_after(std::uint64_t cycles) const
+{
+    return (UINT64_MAX - clock_cycles < cycles) ? UINT64_MAX : clock_cycles + cycles;
+}
+
+template <class Bus>
+void BasicCPU<Bus>::trap()
+{
+    // leave PC on the offending opcode so the host can see where we stopped
+    PC--;
+    interrupt = true;
+}
+
+//* Get functions *//
+
+template <class Bus>
+Byte BasicCPU<Bus>::getA() const { return A; }
+template <class Bus>
+Byte BasicCPU<Bus>::getX() const { return X; }
+template <class Bus>
+Byte BasicCPU<Bus>::getY() const { return Y; }
+template <class Bus>
+Byte BasicCPU<Bus>::getSP() const { return SP; }
+template <class Bus>
+Byte BasicCPU<Bus>::getSR() const { return SR; }
+template <class Bus>
+Word BasicCPU<Bus>::getPC() const { return PC; }
+template <class Bus>
+std::uint64_t BasicCPU<Bus>::getCycles() const { return clock_cycles; }
+
+//* Set functions *//
+
+template <class Bus>
+void BasicCPU<Bus>::setA(Byte b) { A = b; }
+template <class Bus>
+void BasicCPU<Bus>::setX(Byte b) { X = b; }
+template <class Bus>
+void BasicCPU<Bus>::setY(Byte b) { Y = b; }
+template <class Bus>
+void BasicCPU<Bus>::setSP(Byte b) { SP = b; }
+template <class Bus>
+void BasicCPU<Bus>::setSR(Byte b) { SR = b; }
+template <class Bus>
+void BasicCPU<Bus>::setPC(Word address) { PC = address; }
+
+//** Switch Engine **//
+
+// One dispatch per instruction. Each case instantiates the (op, mode)
+// policies from the opcode map in cpu_ops.h, so addressing and operation
+// are inlined together and the effective address never leaves a register.
+// With an inline bus the memory accesses are inlined as well.
+//
+// Lazy instantiates every case with lazy N/Z: most of those flags are
+// overwritten before anything looks at them, so results only store nz, and
+// SR is whole again when the loop returns.
+
+template <class Bus>
+template <bool Lazy>
+CPU_FLATTEN void BasicCPU<Bus>::run_switch(std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    if (Lazy)
+    {
+        defer_flags();
+    }
+    while (!interrupt && clock_cycles < cycle_limit && PC != stop_at)
+    {
+        opcode = fetch();
+        switch (opcode)
+        {
+#define CPU_CASE(code, mnemonic, addressing, cycles)                               \
+    case code:                                                                     \
+        execute<typename op::mnemonic, typename mode::addressing, cycles, Lazy ? LAZY_NZ : EAGER_FLAGS>(); \
+        break;
+            CPU_OPCODES(CPU_CASE)
+#undef CPU_CASE
+        default:
+            trap();
+            break;
+        }
+    }
+    if (Lazy)
+    {
+        materialize_flags();
+    }
+}
+
+template class BasicCPU<Memory>;
+template class BasicCPU<FlatMemory>;
+template void BasicCPU<Memory>::run_switch<true>(std::uint64_t cycle_limit, std::int32_t stop_at);
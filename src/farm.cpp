@@ -0,0 +1,171 @@
+#include "farm.h"
+
+#include <algorithm>
+
+Farm::Farm(std::size_t workers, CPU::engine core)
+{
+    if (workers == 0)
+    {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    next_worker = 0;
+    available = 0;
+    unfinished = 0;
+    stopping = false;
+
+    for (std::size_t i = 0; i < workers; i++)
+    {
+        this->workers.push_back(std::make_unique<Worker>());
+        this->workers.back()->stats = {0, 0, 0, 0, 0, 0};
+        this->workers.back()->cpu.setEngine(core);
+    }
+    // start threads only once the vector stops moving
+    for (std::size_t i = 0; i < workers; i++)
+    {
+        this->workers[i]->thread = std::thread(&Farm::work, this, i);
+    }
+}
+
+Farm::~Farm()
+{
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto &worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+std::size_t Farm::size() const { return workers.size(); }
+
+void Farm::submit(farm_job job)
+{
+    Worker &target = *workers[next_worker++ % workers.size()];
+    {
+        std::lock_guard<std::mutex> guard(target.lock);
+        target.jobs.push_back({std::move(job), clock::now()});
+    }
+    {
+        // under state_lock so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> guard(state_lock);
+        unfinished++;
+        available++;
+    }
+    work_ready.notify_one();
+}
+
+void Farm::wait()
+{
+    std::unique_lock<std::mutex> guard(state_lock);
+    all_done.wait(guard, [this] { return unfinished == 0; });
+}
+
+std::vector<worker_stats> Farm::getStats() const
+{
+    std::vector<worker_stats> stats;
+    for (const auto &worker : workers)
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        stats.push_back(worker->stats);
+    }
+    return stats;
+}
+
+//** Workers **//
+
+bool Farm::take(std::size_t self, queued &out)
+{
+    {
+        // newest first from our own deque: its image is most likely still cached
+        Worker &own = *workers[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.jobs.empty())
+        {
+            out = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            available--;
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < workers.size(); i++)
+    {
+        // oldest first from a victim, which also bounds its queue latency
+        Worker &victim = *workers[(self + i) % workers.size()];
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.jobs.empty())
+            {
+                continue;
+            }
+            out = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            available--;
+        }
+
+        // never hold two worker locks at once
+        std::lock_guard<std::mutex> guard(workers[self]->lock);
+        workers[self]->stats.steals++;
+        return true;
+    }
+    return false;
+}
+
+void Farm::execute(Worker &worker, queued &item)
+{
+    clock::time_point start = clock::now();
+    const farm_job &job = item.job;
+
+    worker.cpu.reset();
+    const std::vector<Byte> &image = *job.image;
+    worker.memory.load(job.load_address, image.data(), image.size());
+    worker.cpu.setPC(job.entry);
+    std::uint64_t cycles = worker.cpu.run_for(job.budget);
+    if (job.extract)
+    {
+        job.extract(worker.cpu, worker.memory);
+    }
+
+    clock::time_point end = clock::now();
+    std::uint64_t queue_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start - item.submitted).count();
+    std::uint64_t busy_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::lock_guard<std::mutex> guard(worker.lock);
+    worker.stats.jobs++;
+    worker.stats.cycles += cycles;
+    worker.stats.busy_ns += busy_ns;
+    worker.stats.queue_ns += queue_ns;
+    worker.stats.max_queue_ns = std::max(worker.stats.max_queue_ns, queue_ns);
+}
+
+void Farm::work(std::size_t self)
+{
+    Worker &worker = *workers[self];
+    while (true)
+    {
+        queued item;
+        if (take(self, item))
+        {
+            execute(worker, item);
+            item = queued();
+
+            std::lock_guard<std::mutex> guard(state_lock);
+            if (--unfinished == 0)
+            {
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(state_lock);
+        work_ready.wait(guard, [this] { return stopping || available > 0; });
+        if (stopping && available == 0)
+        {
+            return;
+        }
+    }
+}
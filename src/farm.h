@@ -0,0 +1,97 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu.h"
+#include "memory.h"
+#include "types.h"
+
+// One emulation run: load image at load_address into a fresh machine, start
+// at entry, and stop at BRK/ILL or once budget cycles have been spent.
+// extract then runs on the worker thread to copy out whatever the caller
+// wants; it must not throw.
+struct farm_job
+{
+    std::shared_ptr<const std::vector<Byte>> image; // shared, so one image can feed many jobs
+    Word load_address;
+    Word entry;
+    std::uint64_t budget;
+    std::function<void(CPU &cpu, Memory &memory)> extract;
+};
+
+struct worker_stats
+{
+    std::uint64_t jobs;
+    std::uint64_t cycles;        // emulated cycles over all jobs
+    std::uint64_t busy_ns;       // time spent loading, running and extracting
+    std::uint64_t queue_ns;      // total time jobs waited between submit and start
+    std::uint64_t max_queue_ns;  // longest single wait
+    std::uint64_t steals;        // jobs taken from another worker's queue
+};
+
+// Runs farm_jobs on a fixed pool of threads. Each worker owns one Memory and
+// CPU for its whole life and resets them between jobs. Submitted jobs are
+// dealt round-robin onto per-worker deques; a worker takes from the back of
+// its own deque and, when that is empty, steals from the front of the others.
+class Farm
+{
+public:
+    explicit Farm(std::size_t workers = 0, CPU::engine core = CPU::TABLE); // 0: one per core
+    ~Farm();                                                                // drains the queues first
+    Farm(const Farm &) = delete;
+    Farm &operator=(const Farm &) = delete;
+
+    void submit(farm_job job);
+    void wait(); // until every submitted job has finished
+
+    std::size_t size() const;
+    std::vector<worker_stats> getStats() const; // one entry per worker
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct queued
+    {
+        farm_job job;
+        clock::time_point submitted;
+    };
+
+    struct Worker
+    {
+        mutable std::mutex lock; // guards jobs and stats
+        std::deque<queued> jobs;
+        worker_stats stats;
+        Memory memory;
+        CPU cpu;
+        std::thread thread;
+
+        Worker() : cpu(&memory) {}
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> next_worker; // round-robin submit target
+    std::atomic<std::size_t> available;   // jobs sitting in any deque
+
+    std::mutex state_lock; // guards unfinished and stopping; pairs with both conditions
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    std::size_t unfinished;
+    bool stopping;
+
+    bool take(std::size_t self, queued &out);
+    void execute(Worker &worker, queued &item);
+    void work(std::size_t self);
+};
+
+#endif // FARM_H
@@ -0,0 +1,367 @@
+#include "jit.h"
+
+#include <cstring>
+
+#if CPU_HAS_JIT
+#include <sys/mman.h>
+#endif
+
+Jit::Jit()
+{
+    code = nullptr;
+    stats = {0, 0, 0, 0};
+#if CPU_HAS_JIT
+    void *map = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map != MAP_FAILED)
+    {
+        code = static_cast<Byte *>(map);
+    }
+#endif
+    cursor = code;
+    trampolines_end = code;
+    leave_from_eax = nullptr;
+    enter_trampoline = nullptr;
+}
+
+Jit::~Jit()
+{
+#if CPU_HAS_JIT
+    if (code != nullptr)
+    {
+        munmap(code, CODE_SIZE);
+    }
+#endif
+}
+
+//** Code Buffer **//
+
+void Jit::open()
+{
+    if (static_cast<std::size_t>(cursor - code) + MAX_BLOCK_BYTES > CODE_SIZE)
+    {
+        flush();
+    }
+#if CPU_HAS_JIT
+    mprotect(code, CODE_SIZE, PROT_READ | PROT_WRITE);
+#endif
+}
+
+void Jit::close()
+{
+#if CPU_HAS_JIT
+    mprotect(code, CODE_SIZE, PROT_READ | PROT_EXEC);
+#endif
+}
+
+void Jit::flush()
+{
+    if (!blocks.empty())
+    {
+        stats.flushes++;
+    }
+    cursor = trampolines_end;
+    blocks.clear();
+    pending.clear();
+    entries.clear();
+}
+
+void Jit::mark_trampolines_end()
+{
+    trampolines_end = cursor;
+}
+
+void *Jit::lookup(Word pc) const
+{
+    auto it = blocks.find(pc);
+    return it == blocks.end() ? nullptr : it->second;
+}
+
+void Jit::add_block(Word pc, Byte *body)
+{
+    blocks[pc] = body;
+    auto it = pending.find(pc);
+    if (it != pending.end())
+    {
+        for (Byte *rel32 : it->second)
+        {
+            bind(rel32, body);
+            stats.links++;
+        }
+        pending.erase(it);
+    }
+    stats.translations++;
+}
+
+//** Assembler **//
+
+void Jit::emit8(Byte b)
+{
+    *cursor++ = b;
+}
+
+void Jit::emit16(std::uint16_t v)
+{
+    std::memcpy(cursor, &v, sizeof(v));
+    cursor += sizeof(v);
+}
+
+void Jit::emit32(std::uint32_t v)
+{
+    std::memcpy(cursor, &v, sizeof(v));
+    cursor += sizeof(v);
+}
+
+void Jit::emit64(std::uint64_t v)
+{
+    std::memcpy(cursor, &v, sizeof(v));
+    cursor += sizeof(v);
+}
+
+void Jit::rex(bool wide, int r, int b)
+{
+    Byte prefix = 0x40 | (wide ? 0x08 : 0) | ((r & 8) ? 0x04 : 0) | ((b & 8) ? 0x01 : 0);
+    if (prefix != 0x40)
+    {
+        emit8(prefix);
+    }
+}
+
+void Jit::modrm_rbx(int r, std::int32_t disp)
+{
+    // mod=10 (disp32), rm=rbx
+    emit8(0x80 | ((r & 7) << 3) | EBX);
+    emit32(disp);
+}
+
+void Jit::push(int r)
+{
+    rex(false, 0, r);
+    emit8(0x50 | (r & 7));
+}
+
+void Jit::pop(int r)
+{
+    rex(false, 0, r);
+    emit8(0x58 | (r & 7));
+}
+
+void Jit::mov_ri(int dst, std::uint32_t imm)
+{
+    rex(false, 0, dst);
+    emit8(0xB8 | (dst & 7));
+    emit32(imm);
+}
+
+void Jit::mov_ri64(int dst, std::uint64_t imm)
+{
+    rex(true, 0, dst);
+    emit8(0xB8 | (dst & 7));
+    emit64(imm);
+}
+
+void Jit::mov_rr64(int dst, int src)
+{
+    rex(true, src, dst);
+    emit8(0x89);
+    emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void Jit::op_rr(Byte opcode, int dst, int src)
+{
+    rex(false, src, dst);
+    emit8(opcode);
+    emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void Jit::alu_ri(alu ext, int dst, std::int32_t imm)
+{
+    rex(false, 0, dst);
+    emit8(0x81);
+    emit8(0xC0 | (ext << 3) | (dst & 7));
+    emit32(imm);
+}
+
+void Jit::load8(int dst, std::int32_t disp)
+{
+    rex(false, dst, EBX);
+    emit8(0x0F);
+    emit8(0xB6);
+    modrm_rbx(dst, disp);
+}
+
+void Jit::load16(int dst, std::int32_t disp)
+{
+    rex(false, dst, EBX);
+    emit8(0x0F);
+    emit8(0xB7);
+    modrm_rbx(dst, disp);
+}
+
+void Jit::store8(std::int32_t disp, int src)
+{
+    rex(false, src, EBX);
+    emit8(0x88);
+    modrm_rbx(src, disp);
+}
+
+void Jit::store16_imm(std::int32_t disp, std::uint16_t v)
+{
+    emit8(0x66);
+    emit8(0xC7);
+    modrm_rbx(0, disp);
+    emit16(v);
+}
+
+void Jit::store16(std::int32_t disp, int src)
+{
+    emit8(0x66);
+    rex(false, src, EBX);
+    emit8(0x89);
+    modrm_rbx(src, disp);
+}
+
+void Jit::load64(int dst, std::int32_t disp)
+{
+    rex(true, dst, EBX);
+    emit8(0x8B);
+    modrm_rbx(dst, disp);
+}
+
+void Jit::store64(std::int32_t disp, int src)
+{
+    rex(true, src, EBX);
+    emit8(0x89);
+    modrm_rbx(src, disp);
+}
+
+void Jit::zero_extend8(int dst, int src)
+{
+    rex(false, dst, src);
+    emit8(0x0F);
+    emit8(0xB6);
+    emit8(0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+void Jit::zero_extend16(int dst, int src)
+{
+    rex(false, dst, src);
+    emit8(0x0F);
+    emit8(0xB7);
+    emit8(0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+void Jit::setcc(cond c, int dst)
+{
+    // only al/cl/dl/bl are addressable without a REX prefix
+    emit8(0x0F);
+    emit8(0x90 | c);
+    emit8(0xC0 | (dst & 7));
+    zero_extend8(dst, dst);
+}
+
+void Jit::add_cycles(std::int32_t n)
+{
+    // add rbp, imm32
+    emit8(0x48);
+    emit8(0x81);
+    emit8(0xC5);
+    emit32(n);
+}
+
+void Jit::add_cycles_reg(int src)
+{
+    // add rbp, r64
+    rex(true, src, EBP);
+    emit8(0x01);
+    emit8(0xC0 | ((src & 7) << 3) | EBP);
+}
+
+void Jit::cmp_cycles_limit()
+{
+    // cmp rbp, [rsp]
+    emit8(0x48);
+    emit8(0x3B);
+    emit8(0x2C);
+    emit8(0x24);
+}
+
+void Jit::test_ri(int dst, std::int32_t imm)
+{
+    rex(false, 0, dst);
+    emit8(0xF7);
+    emit8(0xC0 | (dst & 7));
+    emit32(imm);
+}
+
+void Jit::store_stack32(Byte disp, int src)
+{
+    rex(false, src, 0);
+    emit8(0x89);
+    emit8(0x44 | ((src & 7) << 3)); // [rsp + disp8]
+    emit8(0x24);
+    emit8(disp);
+}
+
+void Jit::load_stack32(int dst, Byte disp)
+{
+    rex(false, dst, 0);
+    emit8(0x8B);
+    emit8(0x44 | ((dst & 7) << 3));
+    emit8(0x24);
+    emit8(disp);
+}
+
+void Jit::call(const void *fn)
+{
+    // mov rax, imm64; call rax
+    emit8(0x48);
+    emit8(0xB8);
+    emit64(reinterpret_cast<std::uint64_t>(fn));
+    emit8(0xFF);
+    emit8(0xD0);
+}
+
+Byte *Jit::jcc(cond c)
+{
+    emit8(0x0F);
+    emit8(0x80 | c);
+    Byte *rel32 = cursor;
+    emit32(0);
+    return rel32;
+}
+
+Byte *Jit::jmp()
+{
+    emit8(0xE9);
+    Byte *rel32 = cursor;
+    emit32(0);
+    return rel32;
+}
+
+void Jit::bind(Byte *rel32, const void *target)
+{
+    std::int32_t offset = static_cast<std::int32_t>(static_cast<const Byte *>(target) - (rel32 + 4));
+    std::memcpy(rel32, &offset, sizeof(offset));
+}
+
+void Jit::exit_to(Word target)
+{
+    // PC goes in eax first so both the budget exit and an unlinked jump
+    // can share the leave trampoline
+    mov_ri(EAX, target);
+    cmp_cycles_limit();
+    bind(jcc(ABOVE_EQUAL), leave_from_eax);
+
+    Byte *link = jmp();
+    void *body = lookup(target);
+    if (body != nullptr)
+    {
+        bind(link, body);
+        stats.links++;
+    }
+    else
+    {
+        bind(link, leave_from_eax);
+        pending[target].push_back(link);
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CPU_HAS_JIT 1
+#else
+#define CPU_HAS_JIT 0
+#endif
+
+class CPU;
+
+struct jit_stats
+{
+    std::uint64_t translations;   // blocks compiled to native code
+    std::uint64_t native_entries; // times the dispatcher entered native code
+    std::uint64_t links;          // exits patched to jump straight to another block
+    std::uint64_t flushes;        // code buffer discarded (invalidation or full)
+};
+
+// Executable code buffer and x86-64 assembler for the JIT engine. The buffer
+// is mapped read/write only while emitting or patching and read/execute
+// otherwise, so it is never writable and executable at once. CPU owns the
+// translation rules (cpu_jit.cpp); this class only knows x86 encodings,
+// where each 6502 block landed, and which exits are waiting for a target.
+class Jit
+{
+public:
+    // hardware register numbers
+    enum reg : Byte
+    {
+        EAX = 0,
+        ECX = 1,
+        EDX = 2,
+        EBX = 3,
+        ESP = 4,
+        EBP = 5,
+        ESI = 6,
+        EDI = 7,
+        R12 = 12,
+        R13 = 13,
+        R14 = 14,
+        R15 = 15
+    };
+
+    // x86 condition codes
+    enum cond : Byte
+    {
+        BELOW = 0x2,
+        ABOVE_EQUAL = 0x3,
+        EQUAL = 0x4,
+        NOT_EQUAL = 0x5
+    };
+
+    // 81 /ext group
+    enum alu : Byte
+    {
+        ADD = 0,
+        OR = 1,
+        AND = 4,
+        SUB = 5,
+        XOR = 6,
+        CMP = 7
+    };
+
+    static const std::size_t CODE_SIZE = 1 << 20;
+    static const std::size_t MAX_BLOCK_BYTES = 16 * 1024; // worst case for one block
+
+    Jit();
+    ~Jit();
+    Jit(const Jit &) = delete;
+    Jit &operator=(const Jit &) = delete;
+
+    bool available() const { return code != nullptr; }
+    bool empty() const { return blocks.empty(); }
+
+    //** Code Buffer **//
+
+    void open();  // make the buffer writable, flushing first if it is nearly full
+    void close(); // make it executable again
+    void flush(); // drop every translation but keep the trampolines
+    void mark_trampolines_end();
+
+    void *lookup(Word pc) const;
+    void add_block(Word pc, Byte *body); // register body and patch exits waiting on pc
+    Byte *here() const { return cursor; }
+
+    //** Profiling **//
+
+    std::uint32_t heat(Word pc) { return ++entries[pc]; }
+
+    //** Assembler **//
+
+    void emit8(Byte b);
+    void emit16(std::uint16_t v);
+    void emit32(std::uint32_t v);
+    void emit64(std::uint64_t v);
+
+    void push(int r);
+    void pop(int r);
+    void mov_ri(int dst, std::uint32_t imm);              // mov r32, imm32
+    void mov_ri64(int dst, std::uint64_t imm);            // mov r64, imm64
+    void mov_rr64(int dst, int src);                      // mov r64, r64
+    void op_rr(Byte opcode, int dst, int src);            // opcode r/m32(dst), r32(src)
+    void alu_ri(alu ext, int dst, std::int32_t imm);      // 81 /ext r32, imm32
+    void load8(int dst, std::int32_t disp);               // movzx r32, byte [rbx + disp]
+    void load16(int dst, std::int32_t disp);              // movzx r32, word [rbx + disp]
+    void store8(std::int32_t disp, int src);              // mov byte [rbx + disp], r8
+    void store16_imm(std::int32_t disp, std::uint16_t v); // mov word [rbx + disp], imm16
+    void store16(std::int32_t disp, int src);             // mov word [rbx + disp], r16
+    void load64(int dst, std::int32_t disp);              // mov r64, [rbx + disp]
+    void store64(std::int32_t disp, int src);             // mov [rbx + disp], r64
+    void zero_extend8(int dst, int src);                  // movzx r32, r8
+    void zero_extend16(int dst, int src);                 // movzx r32, r16
+    void setcc(cond c, int dst);                          // setcc r8 + movzx (dst < 4)
+    void add_cycles(std::int32_t n);                      // add rbp, imm
+    void add_cycles_reg(int src);                         // add rbp, r64
+    void cmp_cycles_limit();                              // cmp rbp, [rsp]
+    void test_ri(int dst, std::int32_t imm);              // test r32, imm32
+    void store_stack32(Byte disp, int src);               // mov [rsp + disp], r32
+    void load_stack32(int dst, Byte disp);                // mov r32, [rsp + disp]
+    void call(const void *fn);
+    Byte *jcc(cond c); // returns the rel32 to patch
+    Byte *jmp();
+    void bind(Byte *rel32, const void *target);
+    void exit_to(Word target); // leave with PC = target unless chained to it
+
+    Byte *leave_from_eax;   // store state, PC = ax, return to the dispatcher
+    Byte *enter_trampoline; // void (*)(CPU *cpu, uint64_t limit, void *body)
+
+    jit_stats stats;
+
+private:
+    Byte *code;
+    Byte *cursor;
+    Byte *trampolines_end;
+
+    std::unordered_map<Word, Byte *> blocks;
+    std::unordered_map<Word, std::vector<Byte *>> pending; // exits waiting on a target
+    std::unordered_map<Word, std::uint32_t> entries;
+
+    void rex(bool wide, int r, int b);
+    void modrm_rbx(int r, std::int32_t disp);
+};
+
+#endif // JIT_H
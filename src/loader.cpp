@@ -0,0 +1,265 @@
+#include "loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    int hex_digit(Byte c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+
+    bool ends_with(const std::string &s, const char *suffix)
+    {
+        std::string tail(suffix);
+        if (s.size() < tail.size())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < tail.size(); i++)
+        {
+            char c = s[s.size() - tail.size() + i];
+            if (c >= 'A' && c <= 'Z')
+            {
+                c += 'a' - 'A';
+            }
+            if (c != tail[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+Image::format Image::detect(const std::string &path)
+{
+    if (ends_with(path, ".hex") || ends_with(path, ".ihx"))
+    {
+        return HEX;
+    }
+    if (ends_with(path, ".prg"))
+    {
+        return PRG;
+    }
+    return RAW;
+}
+
+Image::Image()
+{
+    map = nullptr;
+    length = 0;
+}
+
+Image::~Image() { close(); }
+
+bool Image::open(const std::string &path, format f, Word address)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    length = info.st_size;
+    if (length > 0)
+    {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        map = static_cast<Byte *>(mapped);
+    }
+    ::close(fd); // the mapping keeps the file
+
+    bool ok = true;
+    switch (f)
+    {
+    case HEX:
+        ok = parse_hex();
+        break;
+    case PRG:
+        ok = length >= 2;
+        if (ok)
+        {
+            segments.push_back({static_cast<Word>(map[0] | (map[1] << 8)), map + 2, length - 2});
+        }
+        break;
+    default:
+        segments.push_back({address, map, length});
+        break;
+    }
+
+    for (const segment &s : segments)
+    {
+        ok = ok && s.address + s.size <= 0x10000;
+    }
+    if (!ok)
+    {
+        close();
+    }
+    return ok;
+}
+
+void Image::close()
+{
+    segments.clear();
+    decoded.clear();
+    if (map != nullptr)
+    {
+        munmap(map, length);
+        map = nullptr;
+    }
+    length = 0;
+}
+
+bool Image::parse_hex()
+{
+    // decode into one buffer first; segments get their pointers once it stops growing
+    struct record
+    {
+        Word address;
+        std::size_t offset;
+        std::size_t size;
+    };
+    std::vector<record> records;
+
+    std::size_t at = 0;
+    while (at < length)
+    {
+        Byte c = map[at];
+        if (c == '\r' || c == '\n' || c == ' ' || c == '\t')
+        {
+            at++;
+            continue;
+        }
+        if (c != ':')
+        {
+            return false;
+        }
+        at++;
+
+        // every field is hex byte pairs; the checksum makes the sum zero
+        Byte bytes[255 + 5];
+        std::size_t count = 0;
+        while (at + 1 < length && hex_digit(map[at]) >= 0 && hex_digit(map[at + 1]) >= 0)
+        {
+            if (count == sizeof(bytes))
+            {
+                return false;
+            }
+            bytes[count++] = hex_digit(map[at]) << 4 | hex_digit(map[at + 1]);
+            at += 2;
+        }
+        if (count < 5 || count != std::size_t(bytes[0]) + 5)
+        {
+            return false;
+        }
+        Byte sum = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            sum += bytes[i];
+        }
+        if (sum != 0)
+        {
+            return false;
+        }
+
+        Byte type = bytes[3];
+        Word address = bytes[1] << 8 | bytes[2];
+        if (type == 0x00)
+        {
+            records.push_back({address, decoded.size(), bytes[0]});
+            decoded.insert(decoded.end(), bytes + 4, bytes + 4 + bytes[0]);
+        }
+        else if (type == 0x01)
+        {
+            break;
+        }
+        else if (type == 0x02 || type == 0x04)
+        {
+            if (bytes[0] != 2 || bytes[4] != 0 || bytes[5] != 0)
+            {
+                return false; // beyond 64KB
+            }
+        }
+        // 03 and 05 (start address) have no meaning here: the reset vector does
+    }
+
+    for (const record &r : records)
+    {
+        segment *last = segments.empty() ? nullptr : &segments.back();
+        if (last != nullptr && last->address + last->size == r.address &&
+            last->data + last->size == decoded.data() + r.offset)
+        {
+            last->size += r.size; // consecutive records become one copy
+        }
+        else
+        {
+            segments.push_back({r.address, decoded.data() + r.offset, r.size});
+        }
+    }
+    return true;
+}
+
+void Image::load(Memory &memory) const
+{
+    for (const segment &s : segments)
+    {
+        memory.load(s.address, s.data, s.size);
+    }
+}
+
+void Image::boot(CPU &cpu, Memory &memory) const
+{
+    load(memory);
+    cpu.setPC(memory.read_word(0xFFFC));
+}
+
+std::unique_ptr<Rom> Image::rom() const
+{
+    if (segments.size() != 1 || (segments[0].address & 0xFF) != 0)
+    {
+        return nullptr;
+    }
+    return std::make_unique<Rom>(segments[0].data, segments[0].size, true);
+}
+
+Word Image::origin() const
+{
+    return segments.empty() ? 0x0000 : segments[0].address;
+}
+
+std::size_t Image::size() const
+{
+    std::size_t total = 0;
+    for (const segment &s : segments)
+    {
+        total += s.size;
+    }
+    return total;
+}
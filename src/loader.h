@@ -0,0 +1,65 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "memory.h"
+#include "types.h"
+
+// A program image read from disk. The file is memory-mapped, and raw and
+// .prg images are used straight from the mapping: load() copies them into
+// Memory a page at a time, and rom() wraps them as ROM pages without
+// copying at all. Intel HEX is text, so its records are decoded once into
+// contiguous segments. The Image must outlive any machine mapping its rom().
+class Image
+{
+public:
+    enum format : Byte
+    {
+        RAW, // bytes as they are, loaded at the address given to open()
+        HEX, // Intel HEX records (types 00, 01, and 02/04 with a zero base)
+        PRG  // two-byte little-endian load address, then the bytes
+    };
+
+    static format detect(const std::string &path); // .hex/.ihx, .prg, anything else raw
+
+    Image();
+    ~Image();
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    // false if the file is unreadable, malformed or runs past $FFFF
+    bool open(const std::string &path, format f, Word address = 0x0000);
+
+    void load(Memory &memory) const;  // every segment, in bulk
+    void boot(CPU &cpu, Memory &memory) const; // load, then PC from the reset vector at $FFFC
+
+    // One segment starting on a page boundary, as ROM pages over the
+    // mapping; nullptr for anything else. Map it at origin() >> 8.
+    std::unique_ptr<Rom> rom() const;
+
+    Word origin() const;      // address of the first segment
+    std::size_t size() const; // bytes over all segments
+
+private:
+    struct segment
+    {
+        Word address;
+        const Byte *data;
+        std::size_t size;
+    };
+
+    Byte *map;
+    std::size_t length;
+    std::vector<segment> segments;
+    std::vector<Byte> decoded; // HEX data, which segments point into
+
+    void close();
+    bool parse_hex();
+};
+
+#endif // LOADER_H
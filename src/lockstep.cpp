@@ -0,0 +1,792 @@
+#include "lockstep.h"
+
+#include <cstring>
+
+#include "cpu_ops.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LOCKSTEP_AVX2 // gathers in AVX2 when the CPU running us has it
+#endif
+
+// vectors only cross internal functions, so the ABI note does not apply
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// Lockstep engine. Policies mirror CPU::mode and CPU::op, but every value
+// is a vector of lanes and every register update is masked to the lanes
+// taking part in the step.
+
+namespace
+{
+typedef std::uint32_t vec __attribute__((vector_size(32))); // one 32-bit slot per lane
+
+const Byte NEGATIVE = CPU::NEGATIVE;
+const Byte ZERO = CPU::ZERO;
+const Byte CARRY = CPU::CARRY;
+const Byte OVERFLOW = CPU::OVERFLOW;
+const Byte DECIMAL = CPU::DECIMAL;
+
+const vec LANE_OFFSETS = {0x00000, 0x10000, 0x20000, 0x30000, 0x40000, 0x50000, 0x60000, 0x70000};
+
+inline vec broadcast(std::uint32_t value)
+{
+    return vec{} + value;
+}
+
+inline vec select(vec mask, vec a, vec b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+#if defined(LOCKSTEP_AVX2)
+// Only this function is built for AVX2, and only called once the CPU says
+// it has it, so the rest of the binary runs anywhere. Vectors go by
+// reference: the two sides would pass them by value differently.
+__attribute__((target("avx2"))) void gather_avx2(const Byte *ram, const vec &address, const vec &mask, vec &out)
+{
+    __m256i offsets = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&LANE_OFFSETS)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&address)));
+    __m256i words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(ram), offsets,
+                                                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&mask)), 1);
+    words = _mm256_and_si256(words, _mm256_set1_epi32(0xFF));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&out), words);
+}
+
+const bool HAS_AVX2 = [] {
+    __builtin_cpu_init(); // we may run before the library's own constructor
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+#endif
+
+// one byte per lane from that lane's memory; masked-off lanes read 0
+inline vec gather(const Byte *ram, vec address, vec mask)
+{
+#if defined(LOCKSTEP_AVX2)
+    if (HAS_AVX2)
+    {
+        vec words;
+        gather_avx2(ram, address, mask, words);
+        return words;
+    }
+#endif
+    vec bytes = {};
+    for (std::size_t l = 0; l < Lockstep::WIDTH; l++)
+    {
+        if (mask[l])
+        {
+            bytes[l] = ram[LANE_OFFSETS[l] + address[l]];
+        }
+    }
+    return bytes;
+}
+
+// AVX2 has no scatter; stores are rare next to loads and opcode fetches
+inline void scatter(Byte *ram, vec address, vec data, vec mask)
+{
+    for (std::size_t l = 0; l < Lockstep::WIDTH; l++)
+    {
+        if (mask[l])
+        {
+            ram[LANE_OFFSETS[l] + address[l]] = data[l];
+        }
+    }
+}
+} // namespace
+
+struct Lockstep::lanes_state
+{
+    vec A, X, Y, SP, SR, PC;
+    vec halted;
+    vec mask;  // lanes taking part in this step
+    vec extra; // cycles on top of the opcode's base count
+    Byte *ram;
+
+    vec transfer(vec data) // update N/Z from data (0-255) and pass it through
+    {
+        vec sr = (SR & ~(vec{} + (NEGATIVE | ZERO))) | (data & NEGATIVE) | ((vec)(data == 0) & ZERO);
+        SR = select(mask, sr, SR);
+        return data;
+    }
+
+    void assign(vec &reg, vec value)
+    {
+        reg = select(mask, value, reg);
+    }
+
+    void assign_flag(Byte f, vec condition)
+    {
+        assign(SR, select(condition, SR | f, SR & ~(vec{} + f)));
+    }
+
+    void page_cross(vec base, vec address)
+    {
+        extra -= (vec)(((base ^ address) & 0xFF00) != 0) & mask; // true lanes are -1
+    }
+
+    void push(vec data)
+    {
+        scatter(ram, SP | 0x0100, data, mask);
+        assign(SP, (SP - 1) & 0xFF);
+    }
+
+    vec pull()
+    {
+        vec data = gather(ram, SP | 0x0100, mask);
+        assign(SP, (SP + 1) & 0xFF);
+        return data;
+    }
+};
+
+//** Addressing Mode Policies **//
+
+struct Lockstep::mode
+{
+    template <class Mode>
+    struct memory_operand
+    {
+        static vec load(lanes_state &s, vec operand)
+        {
+            return gather(s.ram, Mode::template address<true>(s, operand), s.mask);
+        }
+
+        static void store(lanes_state &s, vec operand, vec data)
+        {
+            scatter(s.ram, Mode::template address<false>(s, operand), data, s.mask);
+        }
+
+        template <class F>
+        static void modify(lanes_state &s, vec operand, F f)
+        {
+            vec address = Mode::template address<false>(s, operand);
+            scatter(s.ram, address, f(gather(s.ram, address, s.mask)), s.mask);
+        }
+    };
+
+    struct implied
+    {
+        static constexpr int length = 0;
+    };
+
+    struct accumulator
+    {
+        static constexpr int length = 0;
+
+        template <class F>
+        static void modify(lanes_state &s, vec, F f)
+        {
+            s.assign(s.A, f(s.A));
+        }
+    };
+
+    struct immediate
+    {
+        static constexpr int length = 1;
+
+        static vec load(lanes_state &, vec operand)
+        {
+            return operand;
+        }
+    };
+
+    struct relative
+    {
+        static constexpr int length = 1;
+    };
+
+    struct zeropage : memory_operand<zeropage>
+    {
+        static constexpr int length = 1;
+
+        template <bool Penalty>
+        static vec address(lanes_state &, vec operand)
+        {
+            return operand;
+        }
+    };
+
+    struct zeropageX : memory_operand<zeropageX>
+    {
+        static constexpr int length = 1;
+
+        template <bool Penalty>
+        static vec address(lanes_state &s, vec operand)
+        {
+            return (operand + s.X) & 0xFF;
+        }
+    };
+
+    struct zeropageY : memory_operand<zeropageY>
+    {
+        static constexpr int length = 1;
+
+        template <bool Penalty>
+        static vec address(lanes_state &s, vec operand)
+        {
+            return (operand + s.Y) & 0xFF;
+        }
+    };
+
+    struct absolute : memory_operand<absolute>
+    {
+        static constexpr int length = 2;
+
+        template <bool Penalty>
+        static vec address(lanes_state &, vec operand)
+        {
+            return operand;
+        }
+    };
+
+    template <vec lanes_state::*Index>
+    struct absolute_indexed : memory_operand<absolute_indexed<Index>>
+    {
+        static constexpr int length = 2;
+
+        template <bool Penalty>
+        static vec address(lanes_state &s, vec operand)
+        {
+            vec address = (operand + s.*Index) & 0xFFFF;
+            if (Penalty)
+            {
+                s.page_cross(operand, address);
+            }
+            return address;
+        }
+    };
+
+    using absoluteX = absolute_indexed<&lanes_state::X>;
+    using absoluteY = absolute_indexed<&lanes_state::Y>;
+
+    struct indirectX : memory_operand<indirectX>
+    {
+        static constexpr int length = 1;
+
+        template <bool Penalty>
+        static vec address(lanes_state &s, vec operand)
+        {
+            vec pointer = (operand + s.X) & 0xFF;
+            vec low_byte = gather(s.ram, pointer, s.mask);
+            vec high_byte = gather(s.ram, (pointer + 1) & 0xFF, s.mask);
+            return (high_byte << 8) | low_byte;
+        }
+    };
+
+    struct indirectY : memory_operand<indirectY>
+    {
+        static constexpr int length = 1;
+
+        template <bool Penalty>
+        static vec address(lanes_state &s, vec operand)
+        {
+            vec low_byte = gather(s.ram, operand, s.mask);
+            vec high_byte = gather(s.ram, (operand + 1) & 0xFF, s.mask);
+            vec base = (high_byte << 8) | low_byte;
+            vec address = (base + s.Y) & 0xFFFF;
+            if (Penalty)
+            {
+                s.page_cross(base, address);
+            }
+            return address;
+        }
+    };
+};
+
+//** Operation Policies **//
+
+struct Lockstep::op
+{
+    template <vec lanes_state::*Reg>
+    struct load
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            s.assign(s.*Reg, s.transfer(M::load(s, operand)));
+        }
+    };
+
+    template <vec lanes_state::*Reg>
+    struct store
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            M::store(s, operand, s.*Reg);
+        }
+    };
+
+    template <vec lanes_state::*From, vec lanes_state::*To>
+    struct transfer
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign(s.*To, s.transfer(s.*From));
+        }
+    };
+
+    template <vec lanes_state::*Reg, Byte Delta>
+    struct step_register
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign(s.*Reg, s.transfer((s.*Reg + Delta) & 0xFF));
+        }
+    };
+
+    template <Byte Delta>
+    struct step_memory
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            M::modify(s, operand, [&s](vec data) { return s.transfer((data + Delta) & 0xFF); });
+        }
+    };
+
+    template <vec lanes_state::*Reg>
+    struct compare
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            vec data = M::load(s, operand);
+            s.assign_flag(CARRY, (vec)(s.*Reg >= data));
+            s.transfer((s.*Reg - data) & 0xFF);
+        }
+    };
+
+    template <Byte F, bool Value>
+    struct set_flag
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign_flag(F, broadcast(Value ? ~0u : 0u));
+        }
+    };
+
+    template <Byte F, bool Value>
+    struct branch
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            vec set = (vec)((s.SR & F) != 0);
+            vec taken = (Value ? set : ~set) & s.mask;
+
+            // offset is signed and relative to the following instruction
+            vec target = (s.PC + ((operand ^ 0x80) - 0x80)) & 0xFFFF;
+            s.extra -= taken;
+            s.extra -= (vec)(((s.PC ^ target) & 0xFF00) != 0) & taken;
+            s.PC = select(taken, target, s.PC);
+        }
+    };
+
+    struct BRK
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.halted |= s.mask;
+        }
+    };
+
+    using LDA = load<&lanes_state::A>;
+    using LDX = load<&lanes_state::X>;
+    using LDY = load<&lanes_state::Y>;
+    using STA = store<&lanes_state::A>;
+    using STX = store<&lanes_state::X>;
+    using STY = store<&lanes_state::Y>;
+    using TAX = transfer<&lanes_state::A, &lanes_state::X>;
+    using TAY = transfer<&lanes_state::A, &lanes_state::Y>;
+    using TSX = transfer<&lanes_state::SP, &lanes_state::X>;
+    using TXA = transfer<&lanes_state::X, &lanes_state::A>;
+    using TYA = transfer<&lanes_state::Y, &lanes_state::A>;
+
+    struct TXS
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign(s.SP, s.X);
+        }
+    };
+
+    struct PHA
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.push(s.A);
+        }
+    };
+
+    struct PHP
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.push(s.SR);
+            s.assign(s.SR, s.SR | (CPU::BREAK | CPU::IGNORED));
+        }
+    };
+
+    struct PLA
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign(s.A, s.transfer(s.pull()));
+        }
+    };
+
+    struct PLP
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec)
+        {
+            s.assign(s.SR, s.pull());
+        }
+    };
+
+    using DEC = step_memory<0xFF>;
+    using INC = step_memory<0x01>;
+    using DEX = step_register<&lanes_state::X, 0xFF>;
+    using DEY = step_register<&lanes_state::Y, 0xFF>;
+    using INX = step_register<&lanes_state::X, 0x01>;
+    using INY = step_register<&lanes_state::Y, 0x01>;
+
+    // Binary lanes stay in the vector; decimal lanes are rare enough to go
+    // through the scalar digit tables one lane at a time.
+    struct ADC
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            vec data = M::load(s, operand);
+            vec carry = s.SR & CARRY;
+            vec value = s.A + data + carry;
+            vec result = value & 0xFF;
+            vec sr = (s.SR & ~(vec{} + (CARRY | OVERFLOW))) | (value >> 8) |
+                     (((s.A ^ value) & (data ^ value) & 0x80) >> 1);
+            vec negative = value;
+            vec decimal = s.mask & (vec)((s.SR & DECIMAL) != 0);
+            for (std::size_t l = 0; l < Lockstep::WIDTH; l++)
+            {
+                if (decimal[l])
+                {
+                    Word bcd = decimal::add(s.A[l], data[l], carry[l]);
+                    result[l] = bcd & 0xFF;
+                    sr[l] = (sr[l] & ~(CARRY | OVERFLOW)) | ((bcd >> 8) & (CARRY | OVERFLOW));
+                    negative[l] = bcd >> 8;
+                }
+            }
+            // Z from the binary sum, N from the decimal high digit
+            sr = (sr & ~(vec{} + (NEGATIVE | ZERO))) | (negative & NEGATIVE) | ((vec)((value & 0xFF) == 0) & ZERO);
+            s.assign(s.SR, sr);
+            s.assign(s.A, result);
+        }
+    };
+
+    struct SBC
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            vec data = M::load(s, operand);
+            vec inverted = data ^ 0xFF;
+            vec carry = s.SR & CARRY;
+            vec value = s.A + inverted + carry;
+            vec result = value & 0xFF;
+            vec decimal = s.mask & (vec)((s.SR & DECIMAL) != 0);
+            for (std::size_t l = 0; l < Lockstep::WIDTH; l++)
+            {
+                if (decimal[l])
+                {
+                    result[l] = decimal::subtract(s.A[l], data[l], carry[l]);
+                }
+            }
+            vec sr = (s.SR & ~(vec{} + (CARRY | OVERFLOW))) | (value >> 8) |
+                     (((s.A ^ value) & (inverted ^ value) & 0x80) >> 1);
+            s.assign(s.SR, sr);
+            s.transfer(value & 0xFF); // flags from the binary difference
+            s.assign(s.A, result);
+        }
+    };
+
+    struct AND
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            s.assign(s.A, s.transfer(s.A & M::load(s, operand)));
+        }
+    };
+
+    struct EOR
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            s.assign(s.A, s.transfer(s.A ^ M::load(s, operand)));
+        }
+    };
+
+    struct ORA
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            s.assign(s.A, s.transfer(s.A | M::load(s, operand)));
+        }
+    };
+
+    struct ASL
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            M::modify(s, operand, [&s](vec data) {
+                s.assign_flag(CARRY, (vec)((data & 0x80) != 0));
+                return s.transfer((data << 1) & 0xFF);
+            });
+        }
+    };
+
+    struct LSR
+    {
+        template <class M>
+        static void apply(lanes_state &s, vec operand)
+        {
+            M::modify(s, operand, [&s](vec data) {
+                s.assign_flag(CARRY, (vec)((data & 0x01) != 0));
+                return s.transfer(data >> 1);
+            });
+        }
+    };
+
+    using CLC = set_flag<CARRY, false>;
+    using CLD = set_flag<CPU::DECIMAL, false>;
+    using CLI = set_flag<CPU::INTERRUPT, false>;
+    using CLV = set_flag<OVERFLOW, false>;
+    using SEC = set_flag<CARRY, true>;
+    using SED = set_flag<CPU::DECIMAL, true>;
+    using SEI = set_flag<CPU::INTERRUPT, true>;
+
+    using CMP = compare<&lanes_state::A>;
+    using CPX = compare<&lanes_state::X>;
+    using CPY = compare<&lanes_state::Y>;
+
+    using BCC = branch<CARRY, false>;
+    using BCS = branch<CARRY, true>;
+    using BEQ = branch<ZERO, true>;
+    using BMI = branch<NEGATIVE, true>;
+    using BNE = branch<ZERO, false>;
+    using BPL = branch<NEGATIVE, false>;
+    using BVC = branch<OVERFLOW, false>;
+    using BVS = branch<OVERFLOW, true>;
+};
+
+//** Engine **//
+
+Lockstep::Lockstep(std::size_t lanes)
+{
+    this->lanes = lanes;
+    padded = (lanes + WIDTH - 1) / WIDTH * WIDTH;
+
+    A.assign(padded, 0);
+    X.assign(padded, 0);
+    Y.assign(padded, 0);
+    SP.assign(padded, 0xFF);
+    SR.assign(padded, 0);
+    PC.assign(padded, 0);
+    stopped.assign(padded, 0);
+    for (std::size_t l = lanes; l < padded; l++)
+    {
+        stopped[l] = ~0u;
+    }
+    cycles.assign(padded, 0);
+    ram.assign(padded * LANE_BYTES + sizeof(std::uint32_t), 0); // a gather reads 4 bytes
+
+    stats = {0, 0};
+}
+
+std::size_t Lockstep::size() const { return lanes; }
+
+template <class Op, class Mode, Byte Cycles>
+inline void Lockstep::execute(lanes_state &s, Word pc)
+{
+    vec operand = {};
+    if constexpr (Mode::length >= 1)
+    {
+        operand = gather(s.ram, broadcast((Word)(pc + 1)), s.mask);
+    }
+    if constexpr (Mode::length == 2)
+    {
+        operand |= gather(s.ram, broadcast((Word)(pc + 2)), s.mask) << 8;
+    }
+    s.assign(s.PC, broadcast((Word)(pc + 1 + Mode::length)));
+    s.extra = broadcast(Cycles) & s.mask;
+    Op::template apply<Mode>(s, operand);
+}
+
+CPU_FLATTEN void Lockstep::run_vector(std::size_t first, const std::uint64_t *limit)
+{
+    lanes_state s;
+    std::memcpy(&s.A, &A[first], sizeof(vec));
+    std::memcpy(&s.X, &X[first], sizeof(vec));
+    std::memcpy(&s.Y, &Y[first], sizeof(vec));
+    std::memcpy(&s.SP, &SP[first], sizeof(vec));
+    std::memcpy(&s.SR, &SR[first], sizeof(vec));
+    std::memcpy(&s.PC, &PC[first], sizeof(vec));
+    std::memcpy(&s.halted, &stopped[first], sizeof(vec));
+    s.ram = &ram[first * LANE_BYTES];
+    std::uint64_t *lane_cycles = &cycles[first];
+
+    while (true)
+    {
+        // live lanes, and the lowest PC among them leads
+        vec live = ~s.halted;
+        std::int32_t leader = -1;
+        for (std::size_t l = 0; l < WIDTH; l++)
+        {
+            if (lane_cycles[l] >= limit[l])
+            {
+                live[l] = 0;
+            }
+            if (live[l] && (leader < 0 || s.PC[l] < s.PC[leader]))
+            {
+                leader = l;
+            }
+        }
+        if (leader < 0)
+        {
+            break;
+        }
+
+        // lanes at the same PC can still hold different code
+        Word pc = s.PC[leader];
+        vec opcodes = gather(s.ram, broadcast(pc), live);
+        Byte opcode = opcodes[leader];
+        s.mask = live & (vec)(s.PC == pc) & (vec)(opcodes == opcode);
+
+        switch (opcode)
+        {
+#define LOCKSTEP_CASE(code, mnemonic, addressing, cycles) \
+    case code:                                            \
+        execute<op::mnemonic, mode::addressing, cycles>(s, pc); \
+        break;
+            CPU_OPCODES(LOCKSTEP_CASE)
+#undef LOCKSTEP_CASE
+        default:
+            s.halted |= s.mask; // ILL: trap with PC on the opcode
+            s.extra = vec{};
+            break;
+        }
+
+        for (std::size_t l = 0; l < WIDTH; l++)
+        {
+            lane_cycles[l] += s.extra[l];
+            stats.lane_instructions += s.mask[l] & 1;
+        }
+        stats.steps++;
+    }
+
+    std::memcpy(&A[first], &s.A, sizeof(vec));
+    std::memcpy(&X[first], &s.X, sizeof(vec));
+    std::memcpy(&Y[first], &s.Y, sizeof(vec));
+    std::memcpy(&SP[first], &s.SP, sizeof(vec));
+    std::memcpy(&SR[first], &s.SR, sizeof(vec));
+    std::memcpy(&PC[first], &s.PC, sizeof(vec));
+    std::memcpy(&stopped[first], &s.halted, sizeof(vec));
+}
+
+void Lockstep::run()
+{
+    std::vector<std::uint64_t> limit(padded, UINT64_MAX);
+    for (std::size_t first = 0; first < padded; first += WIDTH)
+    {
+        run_vector(first, &limit[first]);
+    }
+}
+
+void Lockstep::run_for(std::uint64_t budget)
+{
+    std::vector<std::uint64_t> limit(padded);
+    for (std::size_t l = 0; l < padded; l++)
+    {
+        limit[l] = (UINT64_MAX - cycles[l] < budget) ? UINT64_MAX : cycles[l] + budget;
+    }
+    for (std::size_t first = 0; first < padded; first += WIDTH)
+    {
+        run_vector(first, &limit[first]);
+    }
+}
+
+lockstep_stats Lockstep::getStats() const { return stats; }
+
+//** Lane State **//
+
+void Lockstep::load(std::size_t lane, const CPU &cpu, Memory &memory)
+{
+    A[lane] = cpu.getA();
+    X[lane] = cpu.getX();
+    Y[lane] = cpu.getY();
+    SP[lane] = cpu.getSP();
+    SR[lane] = cpu.getSR();
+    PC[lane] = cpu.getPC();
+    cycles[lane] = cpu.getCycles();
+    stopped[lane] = cpu.halted() ? ~0u : 0;
+    // RAM under any device, as store() writes it back; devices see no reads
+    for (auto page = 0; page < 256; page++)
+    {
+        memory.read_page(page, &ram[lane * LANE_BYTES + page * 256]);
+    }
+}
+
+void Lockstep::store(std::size_t lane, CPU &cpu, Memory &memory)
+{
+    cpu.setA(A[lane]);
+    cpu.setX(X[lane]);
+    cpu.setY(Y[lane]);
+    cpu.setSP(SP[lane]);
+    cpu.setSR(SR[lane]);
+    cpu.setPC(PC[lane]);
+    cpu.clock_cycles = cycles[lane];
+    cpu.interrupt = stopped[lane] != 0;
+
+    // RAM under the page, whatever is mapped over it: unchanged pages stay
+    // shared and clean, and devices see no writes
+    Byte current[256];
+    for (auto page = 0; page < 256; page++)
+    {
+        const Byte *lane_page = &ram[lane * LANE_BYTES + page * 256];
+        memory.read_page(page, current);
+        if (std::memcmp(current, lane_page, 256) != 0)
+        {
+            memory.write_page(page, lane_page);
+        }
+    }
+}
+
+bool Lockstep::halted(std::size_t lane) const { return stopped[lane] != 0; }
+
+Byte Lockstep::read(std::size_t lane, Word address) const { return ram[lane * LANE_BYTES + address]; }
+void Lockstep::write(std::size_t lane, Word address, Byte data) { ram[lane * LANE_BYTES + address] = data; }
+
+Byte Lockstep::getA(std::size_t lane) const { return A[lane]; }
+Byte Lockstep::getX(std::size_t lane) const { return X[lane]; }
+Byte Lockstep::getY(std::size_t lane) const { return Y[lane]; }
+Byte Lockstep::getSP(std::size_t lane) const { return SP[lane]; }
+Byte Lockstep::getSR(std::size_t lane) const { return SR[lane]; }
+Word Lockstep::getPC(std::size_t lane) const { return PC[lane]; }
+std::uint64_t Lockstep::getCycles(std::size_t lane) const { return cycles[lane]; }
+
+void Lockstep::setA(std::size_t lane, Byte b) { A[lane] = b; }
+void Lockstep::setX(std::size_t lane, Byte b) { X[lane] = b; }
+void Lockstep::setY(std::size_t lane, Byte b) { Y[lane] = b; }
+void Lockstep::setSP(std::size_t lane, Byte b) { SP[lane] = b; }
+void Lockstep::setSR(std::size_t lane, Byte b) { SR[lane] = b; }
+void Lockstep::setPC(std::size_t lane, Word address) { PC[lane] = address; }
@@ -0,0 +1,84 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu.h"
+#include "memory.h"
+#include "types.h"
+
+struct lockstep_stats
+{
+    std::uint64_t steps;             // vector steps, each one opcode across up to WIDTH lanes
+    std::uint64_t lane_instructions; // instructions retired summed over lanes
+};
+
+// Many independent machines run in lockstep, WIDTH lanes per vector. The
+// registers live in structure-of-arrays form and each lane owns a 64KB
+// slice of one arena, so operand reads are a single gather per vector
+// (AVX2 when the CPU has it). Lanes that disagree on PC or opcode are
+// masked off for the step: each step runs the lowest PC among the live
+// lanes of a vector, so lanes that split on a branch rejoin as soon as
+// their paths meet again. Results match CPU::run() lane for lane.
+class Lockstep
+{
+public:
+    static const std::size_t WIDTH = 8; // lanes per vector
+
+    explicit Lockstep(std::size_t lanes);
+    std::size_t size() const;
+
+    void load(std::size_t lane, const CPU &cpu, Memory &memory); // registers, cycles and RAM (under any devices)
+    void store(std::size_t lane, CPU &cpu, Memory &memory);      // the same back; only changed pages are written
+
+    void run();                         // every lane until BRK or ILL
+    void run_for(std::uint64_t cycles); // every lane until its own budget is spent
+
+    bool halted(std::size_t lane) const;
+    lockstep_stats getStats() const;
+
+    //** Lane State **//
+
+    Byte read(std::size_t lane, Word address) const;
+    void write(std::size_t lane, Word address, Byte data);
+
+    Byte getA(std::size_t lane) const;
+    Byte getX(std::size_t lane) const;
+    Byte getY(std::size_t lane) const;
+    Byte getSP(std::size_t lane) const;
+    Byte getSR(std::size_t lane) const;
+    Word getPC(std::size_t lane) const;
+    std::uint64_t getCycles(std::size_t lane) const;
+
+    void setA(std::size_t lane, Byte b);
+    void setX(std::size_t lane, Byte b);
+    void setY(std::size_t lane, Byte b);
+    void setSP(std::size_t lane, Byte b);
+    void setSR(std::size_t lane, Byte b);
+    void setPC(std::size_t lane, Word address);
+
+private:
+    static const std::size_t LANE_BYTES = 0x10000;
+
+    std::size_t lanes;
+    std::size_t padded; // lanes rounded up to WIDTH; the extra ones stay halted
+
+    // one 32-bit slot per lane so a vector loads straight from the arrays
+    std::vector<std::uint32_t> A, X, Y, SP, SR, PC, stopped;
+    std::vector<std::uint64_t> cycles;
+    std::vector<Byte> ram; // lane l at l * LANE_BYTES, plus gather padding
+
+    lockstep_stats stats;
+
+    struct lanes_state; // one vector of lanes while it runs
+    struct mode;        // addressing mode policies
+    struct op;          // operation policies
+
+    void run_vector(std::size_t first, const std::uint64_t *limit);
+    template <class Op, class Mode, Byte Cycles>
+    static void execute(lanes_state &s, Word pc);
+};
+
+#endif // LOCKSTEP_H
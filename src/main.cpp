@@ -1,18 +1,38 @@
+#include <iostream>
+
 #include "cpu.h"
+#include "loader.h"
 #include "memory.h"
 
-int main()
+// 6502-emulator [image]: boot an image (raw, .hex or .prg, by extension)
+// from its reset vector and run it until BRK; without one, run a tiny
+// built-in program.
+
+int main(int argc, char **argv)
 {
     Memory memory;
     CPU cpu(&memory);
 
-    // inline a program //
-
-    memory.write(0x0200, 0xA2); // load LDA opcode with immediate addressing
-    memory.write(0x0201, 0x42); // load literal we want to load into A
-    memory.write(0x0202, 0x00); // Break CPU execution
+    if (argc > 1)
+    {
+        Image image;
+        if (!image.open(argv[1], Image::detect(argv[1])))
+        {
+            std::cerr << argv[0] << ": cannot load " << argv[1] << "\n";
+            return 1;
+        }
+        image.boot(cpu, memory);
+    }
+    else
+    {
+        const Byte program[] = {
+            0xA2, 0x42, // LDX #$42
+            0x00,       // BRK
+        };
+        memory.load(0x0200, program, sizeof(program));
+        cpu.setPC(0x0200);
+    }
 
-    cpu.setPC(0x0200);
     cpu.run();
     return 0;
 }
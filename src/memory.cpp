@@ -1,31 +1,610 @@
 #include "memory.h"
 
-Memory::Memory()
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// all zero, and refs 0 so it is never private
+Memory::Page Memory::zero_page = {{0}, false, nullptr, Memory::zero_page.storage, {}, {}};
+
+Memory::Memory() : Memory(nullptr) {}
+
+Memory::Memory(MemoryPool *pool)
 {
-    for (auto i = 0; i <= MAX_MEM; i++)
+    this->pool = pool;
+    for (auto i = 0; i < 256; i++)
     {
-        RAM[i] = 0x00;
+        pages[i] = &zero_page;
+        watched[i] = false;
+        dirty[i] = false;
+        refresh(i);
     }
+    watcher = nullptr;
+}
+
+Memory::Memory(const Memory &other)
+{
+    pool = other.pool;
+    for (auto i = 0; i < 256; i++)
+    {
+        pages[i] = nullptr;
+        watched[i] = false;
+        dirty[i] = false;
+    }
+    watcher = nullptr;
+    share(other);
+}
+
+Memory &Memory::operator=(const Memory &other)
+{
+    if (this != &other)
+    {
+        share(other);
+    }
+    return *this;
 }
 
 Memory::~Memory()
 {
+    for (auto i = 0; i < 256; i++)
+    {
+        release(pages[i]);
+    }
+}
+
+//** Pages **//
+
+Memory::Page *Memory::new_page()
+{
+    Page *page = pool != nullptr ? new (pool->allocate()) Page : new Page;
+    page->refs.store(1, std::memory_order_relaxed);
+    page->read_only = false;
+    page->pool = pool;
+    page->bytes = page->storage;
+    return page;
+}
+
+void Memory::retain(Page *page)
+{
+    if (page != &zero_page)
+    {
+        page->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Memory::release(Page *page)
+{
+    if (page == nullptr || page == &zero_page || page->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    if (page->pool != nullptr)
+    {
+        MemoryPool *owner = page->pool;
+        page->~Page();
+        owner->release(page);
+    }
+    else
+    {
+        delete page;
+    }
+}
+
+void Memory::share(const Memory &other)
+{
+    if (other.devices)
+    {
+        devices.reset(new Device *[256]);
+        std::copy(other.devices.get(), other.devices.get() + 256, devices.get());
+    }
+    else
+    {
+        devices.reset();
+    }
+    for (auto i = 0; i < 256; i++)
+    {
+        retain(other.pages[i]);
+        if (!other.pages[i]->read_only)
+        {
+            other.write_map[i] = nullptr; // shared now
+        }
+        release(pages[i]);
+        pages[i] = other.pages[i];
+        dirty[i] = other.dirty[i];
+        notify(i); // every page may now hold different bytes
+        refresh(i);
+    }
+}
+
+void Memory::own(Byte page)
+{
+    // only this Memory can raise the count of a page it alone holds, so a
+    // count of one stays one; the zero page never has a count of one. Bytes
+    // in a mapping are read only, however many hold them.
+    if (pages[page]->refs.load(std::memory_order_acquire) == 1 && pages[page]->bytes == pages[page]->storage)
+    {
+        return;
+    }
+    Page *copy = new_page();
+    std::memcpy(copy->bytes, pages[page]->bytes, PAGE_SIZE);
+    release(pages[page]);
+    pages[page] = copy;
+}
+
+void Memory::adopt(Byte page, Page *source)
+{
+    retain(source);
+    release(pages[page]);
+    pages[page] = source;
+    dirty[page] = source != &zero_page;
+    notify(page);
+    refresh(page);
 }
 
+void Memory::notify(Byte page)
+{
+    if (watched[page])
+    {
+        watched[page] = false;
+        refresh(page);
+        watcher->page_written(page);
+    }
+}
+
+void Memory::refresh(Byte page)
+{
+    if (pages[page]->read_only && device_at(page) == nullptr)
+    {
+        // nothing can change the bytes, so watches and counts do not matter
+        read_map[page] = pages[page]->bytes;
+        write_map[page] = rom_sink;
+        return;
+    }
+    bool device = device_at(page) != nullptr;
+    bool writable = !device && !watched[page] && dirty[page] &&
+                    pages[page]->refs.load(std::memory_order_acquire) == 1 &&
+                    pages[page]->bytes == pages[page]->storage; // not in a mapping
+    read_map[page] = device ? nullptr : pages[page]->bytes;
+    write_map[page] = writable ? pages[page]->bytes : nullptr;
+}
+
+std::size_t Memory::private_pages() const
+{
+    std::size_t count = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        count += pages[i]->refs.load(std::memory_order_relaxed) == 1 && !pages[i]->read_only &&
+                 pages[i]->bytes == pages[i]->storage;
+    }
+    return count;
+}
+
+std::size_t Memory::dirty_pages() const
+{
+    std::size_t count = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        count += dirty[i];
+    }
+    return count;
+}
+
+//** Access **//
+
 void Memory::reset()
 {
-    for (auto i = 0; i <= MAX_MEM; i++)
+    for (auto i = 0; i < 256; i++)
+    {
+        if (!dirty[i])
+        {
+            continue; // never written since the last reset: still all zero
+        }
+        // fixed-size memset, which the compiler emits as a few vector stores;
+        // a private page is kept for the next run rather than freed; a
+        // mapped one is never written, so it goes
+        if (pages[i]->refs.load(std::memory_order_acquire) == 1 && pages[i]->bytes == pages[i]->storage)
+        {
+            std::memset(pages[i]->bytes, 0x00, PAGE_SIZE);
+        }
+        else
+        {
+            release(pages[i]);
+            pages[i] = &zero_page;
+        }
+        dirty[i] = false;
+        notify(i);
+        refresh(i);
+    }
+}
+
+Byte Memory::read_slow(Word address)
+{
+    return devices[address >> 8]->read(address);
+}
+
+void Memory::write_slow(Word address, Byte data)
+{
+    Byte page = address >> 8;
+    if (device_at(page) != nullptr)
+    {
+        devices[page]->write(address, data);
+        return;
+    }
+    if (pages[page]->read_only)
+    {
+        return;
+    }
+    own(page);
+    pages[page]->bytes[address & 0xFF] = data;
+    dirty[page] = true;
+    notify(page);
+    refresh(page);
+}
+
+void Memory::read_page(Byte page, Byte *out) const
+{
+    std::memcpy(out, pages[page]->bytes, PAGE_SIZE);
+}
+
+void Memory::write_page(Byte page, const Byte *data)
+{
+    Byte *bytes = writable(page, true);
+    if (bytes != nullptr)
+    {
+        std::memcpy(bytes, data, PAGE_SIZE);
+    }
+}
+
+Byte *Memory::writable(Byte page, bool overwrite)
+{
+    if (pages[page]->read_only)
+    {
+        return nullptr;
+    }
+    if (overwrite && pages[page]->refs.load(std::memory_order_acquire) != 1)
+    {
+        // about to overwrite all of it, so skip the copy own() would make
+        Page *fresh = new_page();
+        release(pages[page]);
+        pages[page] = fresh;
+    }
+    own(page);
+    dirty[page] = true;
+    notify(page);
+    refresh(page);
+    return pages[page]->bytes;
+}
+
+//** Ranges **//
+
+void Memory::load(Word address, const Byte *data, std::size_t size)
+{
+    std::size_t at = address;
+    std::size_t end = std::min<std::size_t>(at + size, MAX_MEM);
+    while (at < end)
+    {
+        Byte page = at >> 8;
+        std::size_t offset = at & 0xFF;
+        std::size_t length = std::min<std::size_t>(PAGE_SIZE - offset, end - at);
+        if (device_at(page) != nullptr)
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                devices[page]->write(at + i, data[i]);
+            }
+        }
+        else if (Byte *bytes = writable(page, length == PAGE_SIZE))
+        {
+            std::memcpy(bytes + offset, data, length);
+        }
+        data += length;
+        at += length;
+    }
+}
+
+void Memory::dump(Word address, Byte *out, std::size_t size)
+{
+    std::size_t at = address;
+    std::size_t end = std::min<std::size_t>(at + size, MAX_MEM);
+    while (at < end)
+    {
+        Byte page = at >> 8;
+        std::size_t offset = at & 0xFF;
+        std::size_t length = std::min<std::size_t>(PAGE_SIZE - offset, end - at);
+        if (device_at(page) != nullptr)
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                out[i] = devices[page]->read(at + i);
+            }
+        }
+        else
+        {
+            std::memcpy(out, pages[page]->bytes + offset, length);
+        }
+        out += length;
+        at += length;
+    }
+}
+
+void Memory::fill(Word address, Byte value, std::size_t size)
+{
+    std::size_t at = address;
+    std::size_t end = std::min<std::size_t>(at + size, MAX_MEM);
+    while (at < end)
+    {
+        Byte page = at >> 8;
+        std::size_t offset = at & 0xFF;
+        std::size_t length = std::min<std::size_t>(PAGE_SIZE - offset, end - at);
+        if (device_at(page) != nullptr)
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                devices[page]->write(at + i, value);
+            }
+        }
+        else if (value == 0x00 && length == PAGE_SIZE && !pages[page]->read_only)
+        {
+            adopt(page, &zero_page); // a cleared page is the zero page again, and clean
+        }
+        else if (Byte *bytes = writable(page, length == PAGE_SIZE))
+        {
+            std::memset(bytes + offset, value, length);
+        }
+        at += length;
+    }
+}
+
+int Memory::compare(Word address, const Byte *data, std::size_t size)
+{
+    std::size_t at = address;
+    std::size_t end = std::min<std::size_t>(at + size, MAX_MEM);
+    while (at < end)
+    {
+        Byte page = at >> 8;
+        std::size_t offset = at & 0xFF;
+        std::size_t length = std::min<std::size_t>(PAGE_SIZE - offset, end - at);
+        if (device_at(page) != nullptr)
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                Byte b = devices[page]->read(at + i);
+                if (b != data[i])
+                {
+                    return b < data[i] ? -1 : 1;
+                }
+            }
+        }
+        else if (int order = std::memcmp(pages[page]->bytes + offset, data, length))
+        {
+            return order;
+        }
+        data += length;
+        at += length;
+    }
+    return 0;
+}
+
+ConstSpan Memory::view(Word address, std::size_t size) const
+{
+    Byte page = address >> 8;
+    if (device_at(page) != nullptr)
+    {
+        return {nullptr, 0};
+    }
+    std::size_t offset = address & 0xFF;
+    return {pages[page]->bytes + offset, std::min<std::size_t>(size, PAGE_SIZE - offset)};
+}
+
+Span Memory::edit(Word address, std::size_t size)
+{
+    Byte page = address >> 8;
+    Byte *bytes = device_at(page) == nullptr ? writable(page, false) : nullptr;
+    if (bytes == nullptr)
+    {
+        return {nullptr, 0};
+    }
+    std::size_t offset = address & 0xFF;
+    return {bytes + offset, std::min<std::size_t>(size, PAGE_SIZE - offset)};
+}
+
+//** Mappings **//
+
+Device *Memory::device_at(Byte page) const
+{
+    return devices ? devices[page] : nullptr;
+}
+
+bool Memory::steady(Byte page) const
+{
+    Device *device = device_at(page);
+    return device == nullptr || device->steady();
+}
+
+void Memory::map_device(Byte page, Device *device)
+{
+    if (!devices)
+    {
+        devices.reset(new Device *[256]());
+    }
+    devices[page] = device;
+    notify(page); // code decoded from the page is gone
+    refresh(page);
+}
+
+void Memory::map_rom(Byte page, const Rom &rom)
+{
+    for (std::size_t i = 0; i < rom.pages.size() && page + i < 256; i++)
+    {
+        Byte target = page + i;
+        adopt(target, rom.pages[i]);
+        dirty[target] = false; // reset() leaves ROM in place
+    }
+}
+
+void Memory::set_watcher(PageWatcher *w)
+{
+    watcher = w;
+    for (auto i = 0; i < 256; i++)
     {
-        RAM[i] = 0x00;
+        watched[i] = false;
+        refresh(i);
     }
 }
 
-Byte Memory::read(Word address)
+void Memory::watch_page(Byte page)
 {
-    return RAM[address];
+    watched[page] = watcher != nullptr;
+    refresh(page);
 }
 
-void Memory::write(Word address, Byte data)
+void Memory::unwatch_page(Byte page)
 {
-    RAM[address] = data;
+    watched[page] = false;
+    refresh(page);
 }
+
+//** Rom **//
+
+Rom::Rom(const Byte *data, std::size_t size) : Rom(data, size, false) {}
+
+Rom::Rom(const Byte *data, std::size_t size, bool borrow)
+{
+    for (std::size_t offset = 0; offset < size; offset += Memory::PAGE_SIZE)
+    {
+        Memory::Page *page = new Memory::Page;
+        page->refs.store(1, std::memory_order_relaxed);
+        page->read_only = true;
+        page->pool = nullptr;
+        std::size_t length = std::min<std::size_t>(Memory::PAGE_SIZE, size - offset);
+        if (borrow && length == Memory::PAGE_SIZE)
+        {
+            page->bytes = const_cast<Byte *>(data + offset); // never written: the page is read only
+        }
+        else
+        {
+            page->bytes = page->storage;
+            std::memcpy(page->bytes, data + offset, length);
+            std::memset(page->bytes + length, 0x00, Memory::PAGE_SIZE - length);
+        }
+        pages.push_back(page);
+    }
+}
+
+Rom::Rom(const std::vector<Byte> &image) : Rom(image.data(), image.size()) {}
+
+Rom::~Rom()
+{
+    for (Memory::Page *page : pages)
+    {
+        Memory::release(page);
+    }
+}
+
+std::size_t Rom::size() const { return pages.size(); }
+
+//** MemoryPool **//
+
+MemoryPool::MemoryPool(bool huge_pages)
+{
+    cursor = nullptr;
+    end = nullptr;
+    free_list = nullptr;
+    stats = {0, 0, 0, huge_pages};
+}
+
+MemoryPool::~MemoryPool()
+{
+    for (Byte *arena : arenas)
+    {
+#if defined(__linux__)
+        munmap(arena, ARENA_BYTES);
+#else
+        std::free(arena);
+#endif
+    }
+}
+
+pool_stats MemoryPool::getStats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+void *MemoryPool::allocate()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    stats.pages_used++;
+    if (free_list != nullptr)
+    {
+        Free *page = free_list;
+        free_list = page->next;
+        stats.pages_free--;
+        return page;
+    }
+    if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(Memory::Page)))
+    {
+        grow();
+    }
+    void *page = cursor;
+    cursor += sizeof(Memory::Page);
+    return page;
+}
+
+void MemoryPool::release(void *page)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Free *entry = static_cast<Free *>(page);
+    entry->next = free_list;
+    free_list = entry;
+    stats.pages_used--;
+    stats.pages_free++;
+}
+
+void MemoryPool::grow()
+{
+    Byte *arena = nullptr;
+#if defined(__linux__)
+    // over-map by one arena and trim, so the arena starts on a 2MB boundary
+    // and can be backed by a single huge page
+    void *map = mmap(nullptr, 2 * ARENA_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+    std::uintptr_t base = reinterpret_cast<std::uintptr_t>(map);
+    std::uintptr_t aligned = (base + ARENA_BYTES - 1) & ~(std::uintptr_t)(ARENA_BYTES - 1);
+    if (aligned > base)
+    {
+        munmap(map, aligned - base);
+    }
+    munmap(reinterpret_cast<void *>(aligned + ARENA_BYTES), base + ARENA_BYTES - aligned);
+    arena = reinterpret_cast<Byte *>(aligned);
+    if (stats.huge_pages && madvise(arena, ARENA_BYTES, MADV_HUGEPAGE) != 0)
+    {
+        stats.huge_pages = false; // THP disabled or unsupported; arenas still pack pages
+    }
+#else
+    arena = static_cast<Byte *>(std::aligned_alloc(ARENA_BYTES, ARENA_BYTES));
+    if (arena == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    stats.huge_pages = false;
+#endif
+    arenas.push_back(arena);
+    stats.arenas++;
+    cursor = arena;
+    end = arena + ARENA_BYTES;
+}
+
+//** FlatMemory **//
+
+FlatMemory::FlatMemory() { reset(); }
+
+void FlatMemory::reset() { std::memset(RAM, 0, sizeof(RAM)); }
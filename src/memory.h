@@ -2,21 +2,285 @@
 #define MEMORY_H
 
 #include "types.h"
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+class MemoryPool;
+class Rom;
+
+// Notified when a write lands on a page marked with Memory::watch_page().
+class PageWatcher
+{
+public:
+    virtual ~PageWatcher() = default;
+    virtual void page_written(Byte page) = 0;
+};
+
+// A memory-mapped peripheral. It sees the full address, so one device can
+// cover several pages.
+class Device
+{
+public:
+    virtual ~Device() = default;
+    virtual Byte read(Word address) = 0;
+    virtual void write(Word address, Byte data) = 0;
+
+    // Reads have no side effects and only change through write() or the
+    // host between runs, so the CPU may treat a loop polling it as idle.
+    virtual bool steady() const { return false; }
+};
+
+// A run of guest bytes in host memory, valid until the Memory it came from
+// is next forked, reset or remapped. Never crosses a page.
+template <class T>
+struct BasicSpan
+{
+    T *data;
+    std::size_t size;
+
+    T *begin() const { return data; }
+    T *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+typedef BasicSpan<Byte> Span;
+typedef BasicSpan<const Byte> ConstSpan;
+
+// 64KB address space as a table of 256 pages. Pages are reference counted,
+// so copying a Memory (a fork) only copies the table; the first write to a
+// page that is still shared gives the writer its own copy. A new Memory is
+// sparse: every page is one process-wide zero page, and a private page is
+// only allocated by the first write to it, so a machine that touches ten
+// pages costs ten pages. Watches and the
+// watcher belong to one Memory and are never copied; device mappings are
+// copied by pointer.
+//
+// Forking reads the source's page table and takes away its write
+// pointers, so the source must be quiescent: nothing may run on it or
+// write to it while the fork is made. Once made, the fork and the source
+// may run on different threads; the page counts they share are atomic.
+//
+// read_map/write_map hold a direct pointer for every page that can be
+// accessed as plain bytes, so RAM reads and writes inline to one indexed
+// load or store. Device pages, watched pages, shared pages and clean pages
+// have no write pointer (device pages no read pointer either) and take the
+// slow path. The first write to a clean page marks it dirty there, so the
+// fast path stays a plain store and reset() only clears dirty pages.
+// ROM pages read from the shared image and write into a per-Memory sink
+// that is never read, so a write to ROM is dropped by the same plain store.
 class Memory
 {
 private:
     // 256 memory pages, each containing 256 bytes.
-    static const std::uint16_t MAX_MEM = (256 * 256) - 1; // 64KB
-    Byte RAM[MAX_MEM];
+    static const std::uint32_t MAX_MEM = 256 * 256; // 64KB
+    static const std::uint32_t PAGE_SIZE = 256;
+
+    struct Page
+    {
+        std::atomic<std::uint32_t> refs;
+        bool read_only;   // part of a Rom: never written, whatever the count
+        MemoryPool *pool; // where the page goes back to; nullptr for the heap
+        Byte *bytes;      // storage, or a mapped save state (copied before any write)
+        Byte storage[PAGE_SIZE];
+        std::shared_ptr<const void> mapping; // keeps the mapping bytes points into alive
+    };
+    friend class MemoryPool;
+    friend class Rom;
+    friend class SaveState;
+
+    Page *pages[256];
+    std::unique_ptr<Device *[]> devices; // allocated by the first map_device()
+
+    const Byte *read_map[256];
+    mutable Byte *write_map[256]; // cleared by forks of this Memory, made while it is quiescent
+
+    // pages holding predecoded code; writing one tells the watcher
+    bool watched[256];
+    PageWatcher *watcher;
+
+    // written since construction or the last reset(); clean pages are all zero
+    bool dirty[256];
+
+    MemoryPool *pool; // new pages come from here; nullptr for the heap
+
+    Byte rom_sink[PAGE_SIZE]; // write target of every ROM page, never read
+
+    static Page zero_page; // shared by every Memory for pages never written; read only
+
+    Page *new_page(); // refs 1, bytes uninitialised
+    static void retain(Page *page);
+    static void release(Page *page);
+    void share(const Memory &other);
+    void own(Byte page); // give this Memory a private copy before a write
+    void adopt(Byte page, Page *source); // share source as the page's contents
+    void notify(Byte page);
+    void refresh(Byte page); // recompute the page's fast-path pointers
+    Byte *writable(Byte page, bool overwrite); // own, dirty and notify before a bulk write; nullptr for ROM
+
+    Device *device_at(Byte page) const;
+    Byte read_slow(Word address);
+    void write_slow(Word address, Byte data);
 
 public:
     Memory();
+    explicit Memory(MemoryPool *pool);  // pages come from pool, which must outlive them
+    Memory(const Memory &other);        // O(1) fork: shares every page, allocates from other's pool
+    Memory &operator=(const Memory &other);
     ~Memory();
-    void reset();
+    void reset(); // zeroes the dirty pages only
     Byte read(Word address);
     void write(Word address, Byte data);
+    Word read_word(Word address); // little-endian; one fast-path lookup when both bytes share a page
+
+    // whole pages of the RAM (or ROM) under a page, bypassing any device
+    void read_page(Byte page, Byte *out) const;
+    void write_page(Byte page, const Byte *data); // ignored for ROM pages
+
+    // Ranges, a page-sized copy at a time; device pages get one read() or
+    // write() per byte, ROM pages ignore writes. All stop at $FFFF.
+    void load(Word address, const Byte *data, std::size_t size);
+    void dump(Word address, Byte *out, std::size_t size);
+    void fill(Word address, Byte value, std::size_t size);
+    int compare(Word address, const Byte *data, std::size_t size); // as memcmp
+
+    // Direct access to the bytes from address to at most the end of its
+    // page; empty for device pages, and edit() is empty for ROM pages.
+    // edit() makes the page private and dirty and tells the watcher up
+    // front, so writes through the span are not seen by a watch set later.
+    ConstSpan view(Word address, std::size_t size) const;
+    Span edit(Word address, std::size_t size);
+
+    std::size_t private_pages() const; // pages allocated for this Memory alone
+    std::size_t dirty_pages() const;   // pages a reset() would clear
+
+    void map_device(Byte page, Device *device); // nullptr maps the page back to RAM
+    bool steady(Byte page) const;               // RAM, ROM or a steady() device
+    void map_rom(Byte page, const Rom &rom);    // rom's pages from page on; writes are ignored
+
+    void set_watcher(PageWatcher *w); // nullptr stops all notifications
+    void watch_page(Byte page);
+    void unwatch_page(Byte page);
+};
+
+struct pool_stats
+{
+    std::size_t arenas;     // ARENA_BYTES each, held until the pool is destroyed
+    std::size_t pages_used; // pages held by some Memory
+    std::size_t pages_free; // released pages waiting to be reused
+    bool huge_pages;        // every arena was accepted for transparent huge pages
+};
+
+// Backing store for the pages of many Memory instances. Pages are carved
+// out of 2MB arenas aligned for transparent huge pages, so thousands of
+// machines share a few TLB entries instead of one per 4KB heap page.
+// Released pages go on a free list and are reused; arenas are only
+// returned to the OS when the pool is destroyed. Safe to share between
+// threads.
+class MemoryPool
+{
+public:
+    static const std::size_t ARENA_BYTES = 2 * 1024 * 1024;
+
+    explicit MemoryPool(bool huge_pages = true); // false: plain 4KB pages
+    ~MemoryPool();
+    MemoryPool(const MemoryPool &) = delete;
+    MemoryPool &operator=(const MemoryPool &) = delete;
+
+    pool_stats getStats() const;
+
+private:
+    friend class Memory;
+
+    struct Free
+    {
+        Free *next;
+    };
+
+    mutable std::mutex lock; // guards everything below
+    std::vector<Byte *> arenas;
+    Byte *cursor; // next uncarved page in the newest arena
+    Byte *end;
+    Free *free_list;
+    pool_stats stats;
+
+    void *allocate(); // one Memory::Page
+    void release(void *page);
+    void grow();
+};
+
+// An immutable image, split into pages that any number of Memory instances
+// map with Memory::map_rom(). Every machine reads the same physical bytes,
+// so thousands of machines running one ROM hold one copy of it, and the
+// pages are reference counted, so the Rom may be destroyed while machines
+// still map it.
+class Rom
+{
+public:
+    Rom(const Byte *data, std::size_t size); // the last page is padded with zeros
+    // borrow: whole pages point into data, which must outlive every machine
+    // mapping them (a partial last page is still copied)
+    Rom(const Byte *data, std::size_t size, bool borrow);
+    explicit Rom(const std::vector<Byte> &image);
+    ~Rom();
+    Rom(const Rom &) = delete;
+    Rom &operator=(const Rom &) = delete;
+
+    std::size_t size() const; // in pages
+
+private:
+    friend class Memory;
+    std::vector<Memory::Page *> pages;
+};
+
+inline Byte Memory::read(Word address)
+{
+    const Byte *page = read_map[address >> 8];
+    if (page != nullptr)
+    {
+        return page[address & 0xFF];
+    }
+    return read_slow(address);
+}
+
+inline void Memory::write(Word address, Byte data)
+{
+    Byte *page = write_map[address >> 8];
+    if (page != nullptr)
+    {
+        page[address & 0xFF] = data;
+        return;
+    }
+    write_slow(address, data);
+}
+
+inline Word Memory::read_word(Word address)
+{
+    const Byte *page = read_map[address >> 8];
+    Byte offset = address & 0xFF;
+    if (page != nullptr && offset != 0xFF)
+    {
+        return page[offset] | (page[offset + 1] << 8);
+    }
+    return read(address) | (read(static_cast<Word>(address + 1)) << 8);
+}
+
+// Plain 64KB of RAM: no devices, forks or watches, so every access is one
+// load or store. A bus for BasicCPU when none of that is needed.
+class FlatMemory
+{
+private:
+    Byte RAM[256 * 256];
+
+public:
+    FlatMemory();
+    void reset();
+    Byte read(Word address) { return RAM[address]; }
+    void write(Word address, Byte data) { RAM[address] = data; }
+    Word read_word(Word address) { return RAM[address] | (RAM[static_cast<Word>(address + 1)] << 8); }
 };
 
 #endif // MEMORY_H
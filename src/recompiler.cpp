@@ -0,0 +1,139 @@
+#include "recompiler.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "aot.h"
+
+namespace
+{
+std::string hex(unsigned value, int digits)
+{
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+    return buffer;
+}
+
+std::string label(Word address)
+{
+    return "L" + hex(address, 4);
+}
+} // namespace
+
+Recompiler::Recompiler(Memory &image) : image(image)
+{
+}
+
+void Recompiler::trace(Word entry)
+{
+    std::vector<Word> pending = {entry};
+    while (!pending.empty())
+    {
+        Word pc = pending.back();
+        pending.pop_back();
+
+        while (code.count(pc) == 0)
+        {
+            Byte opcode = image.read(pc);
+            const CPU::aot::opcode_info &info = CPU::aot::describe(opcode);
+            if (!info.implemented)
+            {
+                break; // ILL traps in the interpreter
+            }
+
+            Word operand = 0;
+            if (info.length > 1)
+            {
+                operand = image.read(pc + 1);
+            }
+            if (info.length > 2)
+            {
+                operand |= image.read(pc + 2) << 8;
+            }
+            Word next = pc + info.length;
+            code[pc] = {opcode, operand, next};
+
+            if (opcode == 0x00) // BRK halts
+            {
+                break;
+            }
+            if (info.relative)
+            {
+                pending.push_back(next + static_cast<std::int8_t>(operand));
+            }
+            pc = next;
+        }
+    }
+}
+
+bool Recompiler::reachable(Word address) const
+{
+    return code.count(address) != 0;
+}
+
+std::size_t Recompiler::instructions() const
+{
+    return code.size();
+}
+
+// Continue at target: a goto when it was traced, otherwise return and let
+// the CPU interpret from there.
+void Recompiler::jump(std::string &out, Word from, Word target) const
+{
+    if (!reachable(target))
+    {
+        out += "    return true;\n";
+        return;
+    }
+    auto after = code.find(from);
+    if (++after != code.end() && after->first == target)
+    {
+        return; // falls through
+    }
+    out += "    goto " + label(target) + ";\n";
+}
+
+std::string Recompiler::emit(const std::string &function) const
+{
+    std::string out;
+    out += "// Generated by 6502-aot: " + std::to_string(code.size()) + " instructions.\n";
+    out += "// Valid only for the image it was traced from; do not edit.\n\n";
+    out += "#include \"aot.h\"\n\n";
+    out += "bool " + function + "(CPU &cpu, std::uint64_t cycle_limit, std::int32_t stop_at)\n{\n";
+    out += "    using A = CPU::aot;\n\n";
+
+    out += "    switch (A::pc(cpu))\n    {\n";
+    for (const auto &entry : code)
+    {
+        out += "    case 0x" + hex(entry.first, 4) + ": goto " + label(entry.first) + ";\n";
+    }
+    out += "    default: return false;\n    }\n";
+
+    for (const auto &entry : code)
+    {
+        Word pc = entry.first;
+        const Traced &t = entry.second;
+        const CPU::aot::opcode_info &info = CPU::aot::describe(t.opcode);
+
+        out += "\n" + label(pc) + ": // " + info.mnemonic + "\n";
+        out += "    if (A::stop(cpu, cycle_limit, stop_at)) return true;\n";
+        out += "    if (!A::traced<0x" + hex(t.opcode, 2) + ">(cpu, 0x" + hex(pc, 4) + ", 0x" + hex(t.operand, 4) + ")) return false;\n";
+        out += "    A::step<0x" + hex(t.opcode, 2) + ">(cpu, 0x" + hex(t.operand, 4) + ", 0x" + hex(t.next, 4) + ");\n";
+
+        if (t.opcode == 0x00)
+        {
+            out += "    return true;\n";
+            continue;
+        }
+        if (info.relative)
+        {
+            Word target = t.next + static_cast<std::int8_t>(t.operand);
+            out += "    if (A::pc(cpu) == 0x" + hex(target, 4) + ")\n";
+            out += reachable(target) ? "        goto " + label(target) + ";\n" : "        return true;\n";
+        }
+        jump(out, pc, t.next);
+    }
+
+    out += "}\n";
+    return out;
+}
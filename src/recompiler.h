@@ -0,0 +1,45 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include "memory.h"
+#include "types.h"
+
+// Ahead-of-time translation of a fixed 6502 image into C++ (see aot.h for
+// the runtime). trace() follows fall-through and both branch directions
+// from each entry point; emit() writes one function with a label per
+// traced instruction. Code it never reached, and any instruction whose
+// bytes in memory no longer match the trace (self-modifying code, a store
+// over the image, a different image), is left to the interpreter the CPU
+// falls back on.
+class Recompiler
+{
+public:
+    explicit Recompiler(Memory &image);
+
+    void trace(Word entry); // may be called once per entry point
+    bool reachable(Word address) const;
+    std::size_t instructions() const;
+
+    // C++ source defining `bool <function>(CPU &, uint64_t, int32_t)`,
+    // matching CPU::recompiled
+    std::string emit(const std::string &function) const;
+
+private:
+    struct Traced
+    {
+        Byte opcode;
+        Word operand;
+        Word next;
+    };
+
+    Memory &image;
+    std::map<Word, Traced> code; // ordered so fall-through follows the image
+
+    void jump(std::string &out, Word from, Word target) const;
+};
+
+#endif // RECOMPILER_H
@@ -0,0 +1,241 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const std::size_t PAGE = 256;
+
+    // 16 bytes per step: SSE2 on x86-64, NEON on arm64, scalar elsewhere
+    typedef Byte bytes16 __attribute__((vector_size(16)));
+
+    // diff = a ^ b; true if any byte differs
+    bool xor_page(const Byte *a, const Byte *b, Byte *diff)
+    {
+        bytes16 any = {};
+        for (std::size_t i = 0; i < PAGE; i += sizeof(bytes16))
+        {
+            bytes16 x, y;
+            std::memcpy(&x, a + i, sizeof(x));
+            std::memcpy(&y, b + i, sizeof(y));
+            bytes16 d = x ^ y;
+            std::memcpy(diff + i, &d, sizeof(d));
+            any |= d;
+        }
+        std::uint64_t halves[2];
+        std::memcpy(halves, &any, sizeof(halves));
+        return (halves[0] | halves[1]) != 0;
+    }
+}
+
+Rewind::Rewind(CPU &cpu, Memory &memory, std::size_t capacity, std::uint64_t interval)
+    : cpu(cpu), memory(memory), ring(std::max<std::size_t>(capacity, 1)), shadow(PAGE * 256)
+{
+    this->interval = interval;
+    next_capture = after(cpu.getCycles());
+    oldest = 0;
+    count = 0;
+    captures = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        memory.read_page(i, &shadow[i * PAGE]);
+    }
+}
+
+std::uint64_t Rewind::after(std::uint64_t cycles) const
+{
+    // captures sit on a fixed grid, so instruction overshoot does not drift them
+    if (interval == 0 || cycles / interval >= UINT64_MAX / interval - 1)
+    {
+        return UINT64_MAX;
+    }
+    return (cycles / interval + 1) * interval;
+}
+
+Rewind::snapshot &Rewind::at(std::size_t index)
+{
+    return ring[(oldest + index) % ring.size()];
+}
+
+std::size_t Rewind::size() const { return count; }
+
+std::uint64_t Rewind::cycles_at(std::size_t index) const
+{
+    return ring[(oldest + index) % ring.size()].cycles;
+}
+
+//** Capture **//
+
+void Rewind::capture()
+{
+    if (count == ring.size())
+    {
+        // the oldest delta only leads further back, so it can simply go
+        oldest = (oldest + 1) % ring.size();
+        count--;
+    }
+    snapshot &s = at(count);
+    count++;
+    captures++;
+
+    s.cycles = cpu.getCycles();
+    s.PC = cpu.getPC();
+    s.A = cpu.getA();
+    s.X = cpu.getX();
+    s.Y = cpu.getY();
+    s.SP = cpu.getSP();
+    s.SR = cpu.getSR();
+    s.halted = cpu.halted();
+    s.pages.clear();
+    s.delta.clear();
+
+    Byte current[PAGE], diff[PAGE];
+    for (auto i = 0; i < 256; i++)
+    {
+        memory.read_page(i, current);
+        if (xor_page(current, &shadow[i * PAGE], diff))
+        {
+            s.pages.push_back(i);
+            encode(diff, s.delta);
+            std::memcpy(&shadow[i * PAGE], current, PAGE);
+        }
+    }
+}
+
+std::uint64_t Rewind::run_for(std::uint64_t cycles)
+{
+    std::uint64_t start = cpu.getCycles();
+    std::uint64_t end = (UINT64_MAX - start < cycles) ? UINT64_MAX : start + cycles;
+    while (!cpu.halted() && cpu.getCycles() < end)
+    {
+        if (cpu.getCycles() >= next_capture)
+        {
+            // the CPU was run past the capture point outside run_for()
+            capture();
+            next_capture = after(cpu.getCycles());
+        }
+        cpu.run_for(std::min(end, next_capture) - cpu.getCycles());
+        if (cpu.getCycles() >= next_capture)
+        {
+            capture();
+            next_capture = after(cpu.getCycles());
+        }
+    }
+    return cpu.getCycles() - start;
+}
+
+//** Rewind **//
+
+void Rewind::rewind(std::size_t index)
+{
+    if (index >= count)
+    {
+        return;
+    }
+
+    // walk the shadow back from the newest snapshot to the target
+    for (std::size_t i = count - 1; i > index; i--)
+    {
+        const snapshot &s = at(i);
+        const Byte *in = s.delta.data();
+        for (Byte page : s.pages)
+        {
+            in = apply(in, &shadow[page * PAGE]);
+        }
+    }
+    count = index + 1;
+
+    Byte current[PAGE];
+    for (auto i = 0; i < 256; i++)
+    {
+        memory.read_page(i, current);
+        if (std::memcmp(current, &shadow[i * PAGE], PAGE) != 0)
+        {
+            memory.write_page(i, &shadow[i * PAGE]);
+        }
+    }
+
+    const snapshot &s = at(index);
+    cpu.reset_registers();
+    cpu.setA(s.A);
+    cpu.setX(s.X);
+    cpu.setY(s.Y);
+    cpu.setSP(s.SP);
+    cpu.setSR(s.SR);
+    cpu.setPC(s.PC);
+    cpu.clock_cycles = s.cycles;
+    cpu.interrupt = s.halted;
+    next_capture = after(s.cycles);
+}
+
+bool Rewind::rewind_to(std::uint64_t cycle)
+{
+    for (std::size_t i = count; i > 0; i--)
+    {
+        if (cycles_at(i - 1) <= cycle)
+        {
+            rewind(i - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+rewind_stats Rewind::getStats() const
+{
+    rewind_stats stats = {captures, count, 0, 0};
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const snapshot &s = ring[(oldest + i) % ring.size()];
+        stats.pages += s.pages.size();
+        stats.bytes += s.delta.size();
+    }
+    return stats;
+}
+
+//** Delta Encoding **//
+
+// A page's XOR diff as (zero run, literal count, literals...) tokens, each
+// count at most 255, until the page is covered.
+void Rewind::encode(const Byte *diff, std::vector<Byte> &out)
+{
+    std::size_t position = 0;
+    while (position < PAGE)
+    {
+        std::size_t zeros = 0;
+        while (position + zeros < PAGE && zeros < 255 && diff[position + zeros] == 0)
+        {
+            zeros++;
+        }
+        position += zeros;
+
+        std::size_t literals = 0;
+        while (position + literals < PAGE && literals < 255 && diff[position + literals] != 0)
+        {
+            literals++;
+        }
+        out.push_back(zeros);
+        out.push_back(literals);
+        out.insert(out.end(), diff + position, diff + position + literals);
+        position += literals;
+    }
+}
+
+const Byte *Rewind::apply(const Byte *in, Byte *page)
+{
+    std::size_t position = 0;
+    while (position < PAGE)
+    {
+        position += in[0];
+        std::size_t literals = in[1];
+        in += 2;
+        for (std::size_t i = 0; i < literals; i++)
+        {
+            page[position + i] ^= in[i];
+        }
+        in += literals;
+        position += literals;
+    }
+    return in;
+}
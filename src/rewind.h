@@ -0,0 +1,77 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu.h"
+#include "memory.h"
+#include "types.h"
+
+struct rewind_stats
+{
+    std::uint64_t captures;  // snapshots taken, including evicted ones
+    std::size_t snapshots;   // snapshots held now
+    std::size_t pages;       // page deltas held over all snapshots
+    std::size_t bytes;       // encoded size of those deltas
+};
+
+// Bounded history of one machine for stepping backwards. Each snapshot
+// keeps the registers plus, for every page that changed since the previous
+// snapshot, the XOR of old and new contents, run-length encoded (a page
+// changed by a few stores costs a few bytes). A shadow copy of the newest
+// snapshot's memory turns the deltas into a chain backwards: rewinding
+// XORs deltas onto the shadow from the newest down to the target, so any
+// held point is restored without replaying from the start. When the ring
+// is full the oldest snapshot is dropped.
+class Rewind
+{
+public:
+    // capacity: snapshots held; interval: cycles between captures in run_for(),
+    // which captures on each multiple of it (0: only explicit captures)
+    Rewind(CPU &cpu, Memory &memory, std::size_t capacity, std::uint64_t interval);
+
+    void capture();                              // snapshot the machine now
+    std::uint64_t run_for(std::uint64_t cycles); // run, capturing every interval cycles
+
+    std::size_t size() const;                         // snapshots held
+    std::uint64_t cycles_at(std::size_t index) const; // 0 is the oldest held
+
+    // Restore snapshot index; it becomes the newest and later ones are
+    // dropped, since running on from it makes a different future.
+    void rewind(std::size_t index);
+    bool rewind_to(std::uint64_t cycle); // newest snapshot at or before cycle; false if none
+
+    rewind_stats getStats() const;
+
+private:
+    struct snapshot
+    {
+        std::uint64_t cycles;
+        Word PC;
+        Byte A, X, Y, SP, SR;
+        bool halted;
+        std::vector<Byte> pages; // page numbers with a delta
+        std::vector<Byte> delta; // their encoded deltas, back to back
+    };
+
+    CPU &cpu;
+    Memory &memory;
+    std::uint64_t interval;
+    std::uint64_t next_capture;
+
+    std::vector<snapshot> ring;
+    std::size_t oldest; // ring index of snapshot 0
+    std::size_t count;
+    std::uint64_t captures;
+
+    std::vector<Byte> shadow; // 64KB: memory as of the newest snapshot
+
+    snapshot &at(std::size_t index);
+    std::uint64_t after(std::uint64_t cycles) const; // next capture point
+    static void encode(const Byte *diff, std::vector<Byte> &out);
+    static const Byte *apply(const Byte *in, Byte *page); // XOR one encoded delta into page
+};
+
+#endif // REWIND_H
@@ -0,0 +1,222 @@
+#include "save_state.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    const char MAGIC[8] = {'6', '5', '0', '2', 'S', 'A', 'V', 'E'};
+
+    void put(Byte *out, std::uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+        {
+            out[i] = value >> (8 * i);
+        }
+    }
+
+    std::uint64_t get(const Byte *in, int bytes)
+    {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+        {
+            value |= std::uint64_t(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    bool write_all(int fd, iovec *iov, int count)
+    {
+        while (count > 0)
+        {
+            ssize_t written = writev(fd, iov, count);
+            if (written < 0)
+            {
+                return false;
+            }
+            // a short write leaves us partway through some entry
+            while (count > 0 && static_cast<std::size_t>(written) >= iov->iov_len)
+            {
+                written -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0)
+            {
+                iov->iov_base = static_cast<Byte *>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
+        }
+        return true;
+    }
+}
+
+SaveState::SaveState()
+{
+    map = nullptr;
+    length = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        pages[i] = nullptr;
+    }
+    cycles = 0;
+    PC = 0x0000;
+    A = X = Y = SR = 0x00;
+    SP = 0xFF;
+    halted = false;
+}
+
+SaveState::~SaveState() { close(); }
+
+bool SaveState::save(const std::string &path, const CPU &cpu, const Memory &memory)
+{
+    Byte header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    put(header + 8, VERSION, 4);
+    put(header + 12, HEADER_SIZE, 4);
+    put(header + 16, cpu.getCycles(), 8);
+    put(header + 24, cpu.getPC(), 2);
+    header[26] = cpu.getA();
+    header[27] = cpu.getX();
+    header[28] = cpu.getY();
+    header[29] = cpu.getSP();
+    header[30] = cpu.getSR();
+    header[31] = cpu.halted();
+
+    iovec iov[1 + 256];
+    int count = 1;
+    iov[0] = {header, HEADER_SIZE};
+    for (auto i = 0; i < 256; i++)
+    {
+        // clean RAM pages are zero and stay out of the file
+        const Memory::Page *page = memory.pages[i];
+        if (page != &Memory::zero_page && (memory.dirty[i] || page->read_only))
+        {
+            header[32 + i / 8] |= 1 << (i % 8);
+            iov[count++] = {page->bytes, Memory::PAGE_SIZE};
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = write_all(fd, iov, count);
+    return ::close(fd) == 0 && ok;
+}
+
+bool SaveState::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < HEADER_SIZE)
+    {
+        ::close(fd);
+        return false;
+    }
+    length = info.st_size;
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file
+    if (mapped == MAP_FAILED)
+    {
+        length = 0;
+        return false;
+    }
+    map = static_cast<Byte *>(mapped);
+    std::size_t mapped_length = length;
+    mapping = std::shared_ptr<const void>(mapped, [mapped_length](const void *p) {
+        munmap(const_cast<void *>(p), mapped_length);
+    });
+
+    std::size_t stored = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        stored += (map[32 + i / 8] >> (i % 8)) & 1;
+    }
+    std::size_t header_size = get(map + 12, 4);
+    if (std::memcmp(map, MAGIC, sizeof(MAGIC)) != 0 || get(map + 8, 4) != VERSION ||
+        header_size < HEADER_SIZE || length != header_size + stored * Memory::PAGE_SIZE)
+    {
+        close();
+        return false;
+    }
+
+    cycles = get(map + 16, 8);
+    PC = get(map + 24, 2);
+    A = map[26];
+    X = map[27];
+    Y = map[28];
+    SP = map[29];
+    SR = map[30];
+    halted = map[31] != 0;
+
+    Byte *data = map + header_size;
+    for (auto i = 0; i < 256; i++)
+    {
+        if ((map[32 + i / 8] >> (i % 8)) & 1)
+        {
+            // only the header is allocated; the bytes stay in the mapping
+            Memory::Page *page = new Memory::Page;
+            page->refs.store(1, std::memory_order_relaxed);
+            page->read_only = false;
+            page->pool = nullptr;
+            page->bytes = data;
+            page->mapping = mapping;
+            pages[i] = page;
+            data += Memory::PAGE_SIZE;
+        }
+    }
+    return true;
+}
+
+void SaveState::restore(CPU &cpu, Memory &memory) const
+{
+    for (auto i = 0; i < 256; i++)
+    {
+        // mapped bytes are never written in place: the machine copies first
+        memory.adopt(i, pages[i] != nullptr ? pages[i] : &Memory::zero_page);
+    }
+
+    cpu.reset_registers();
+    cpu.setA(A);
+    cpu.setX(X);
+    cpu.setY(Y);
+    cpu.setSP(SP);
+    cpu.setSR(SR);
+    cpu.setPC(PC);
+    cpu.clock_cycles = cycles;
+    cpu.interrupt = halted;
+}
+
+std::size_t SaveState::stored_pages() const
+{
+    std::size_t count = 0;
+    for (auto i = 0; i < 256; i++)
+    {
+        count += pages[i] != nullptr;
+    }
+    return count;
+}
+
+void SaveState::close()
+{
+    for (auto i = 0; i < 256; i++)
+    {
+        Memory::release(pages[i]);
+        pages[i] = nullptr;
+    }
+    mapping.reset(); // restored machines may still be using it
+    map = nullptr;
+    length = 0;
+}
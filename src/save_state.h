@@ -0,0 +1,63 @@
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "cpu.h"
+#include "memory.h"
+#include "types.h"
+
+// Binary snapshot of a machine: CPU registers, cycle count, halt state and
+// every page of Memory that is not known to be zero. The layout, all
+// little-endian:
+//
+//   0   "6502SAVE"
+//   8   u32 version, u32 header size (64)
+//   16  u64 cycles
+//   24  u16 PC; u8 A, X, Y, SP, SR, halted
+//   32  256-bit map of the pages stored below
+//   64  the stored pages, 256 bytes each, in page order
+//
+// save() writes the file with one writev(). open() maps it and restore()
+// points the machine's pages straight into the mapping, copy-on-write like
+// a fork, so warm-starting many machines from one file copies nothing
+// until they write. Every restored page holds on to the mapping, so the
+// SaveState may go before the machines do. Devices, watches and ROM
+// mappings are not part of the state: ROM pages are saved as their bytes
+// and restored as RAM.
+class SaveState
+{
+public:
+    static const std::uint32_t VERSION = 1;
+    static const std::size_t HEADER_SIZE = 64;
+
+    SaveState();
+    ~SaveState();
+    SaveState(const SaveState &) = delete;
+    SaveState &operator=(const SaveState &) = delete;
+
+    static bool save(const std::string &path, const CPU &cpu, const Memory &memory); // false on I/O errors
+
+    bool open(const std::string &path); // false if unreadable, truncated or another version
+    void restore(CPU &cpu, Memory &memory) const;
+
+    std::size_t stored_pages() const;
+
+private:
+    Byte *map;
+    std::size_t length;
+    std::shared_ptr<const void> mapping; // unmaps once this and every page over it are gone
+    Memory::Page *pages[256]; // headers over the mapping; nullptr for zero pages
+
+    std::uint64_t cycles;
+    Word PC;
+    Byte A, X, Y, SP, SR;
+    bool halted;
+
+    void close();
+};
+
+#endif // SAVE_STATE_H
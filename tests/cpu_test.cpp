@@ -1,8 +1,21 @@
 #include "../src/cpu.h"
+#include "../src/cpu_ops.h"
+#include "../src/farm.h"
+#include "../src/loader.h"
+#include "../src/lockstep.h"
 #include "../src/memory.h"
+#include "../src/recompiler.h"
+#include "../src/rewind.h"
+#include "../src/save_state.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
 
-class CPUTest : public ::testing::Test
+#include <unistd.h>
+
+class CPUTest : public ::testing::TestWithParam<CPU::engine>
 {
 protected:
     Memory memory;
@@ -14,6 +27,8 @@ protected:
     {
         cpu.reset();
         memory.reset();
+        cpu.setEngine(GetParam());
+        cpu.setJitThreshold(0); // translate on first entry so every test runs native code
     }
 
     void TearDown()
@@ -21,9 +36,12 @@ protected:
     }
 };
 
+// every test runs once per execution engine
+INSTANTIATE_TEST_SUITE_P(Engines, CPUTest, ::testing::Values(CPU::TABLE, CPU::SWITCH, CPU::CACHED, CPU::JIT, CPU::LAZY));
+
 //* LDA TESTS *//
 
-TEST_F(CPUTest, LDAImmediate)
+TEST_P(CPUTest, LDAImmediate)
 {
     memory.write(0x0200, 0xA9); // load LDA opcode with immediate addressing
     memory.write(0x0201, 0x42); // load literal we want to load into A
@@ -39,7 +57,7 @@ TEST_F(CPUTest, LDAImmediate)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDAZeroPage)
+TEST_P(CPUTest, LDAZeroPage)
 {
     memory.write(0x0200, 0xA5);
     memory.write(0x0201, 0x80);
@@ -57,7 +75,7 @@ TEST_F(CPUTest, LDAZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDAZeroPageX)
+TEST_P(CPUTest, LDAZeroPageX)
 {
     memory.write(0x0200, 0xB5);
     memory.write(0x0201, 0x80);
@@ -76,7 +94,7 @@ TEST_F(CPUTest, LDAZeroPageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDAAbsolute)
+TEST_P(CPUTest, LDAAbsolute)
 {
     memory.write(0x0200, 0xAD);
     memory.write(0x0201, 0x10);
@@ -95,7 +113,7 @@ TEST_F(CPUTest, LDAAbsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, LDAAbsoluteX)
+TEST_P(CPUTest, LDAAbsoluteX)
 {
     memory.write(0x0200, 0xBD);
     memory.write(0x0201, 0x20);
@@ -115,7 +133,7 @@ TEST_F(CPUTest, LDAAbsoluteX)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, LDAAbsoluteY)
+TEST_P(CPUTest, LDAAbsoluteY)
 {
     memory.write(0x0200, 0xB9);
     memory.write(0x0201, 0x20);
@@ -135,7 +153,7 @@ TEST_F(CPUTest, LDAAbsoluteY)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, LDAIndirectX)
+TEST_P(CPUTest, LDAIndirectX)
 {
     memory.write(0x0200, 0xA1);
     memory.write(0x0201, 0x70);
@@ -158,7 +176,26 @@ TEST_F(CPUTest, LDAIndirectX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDAIndirectY)
+TEST_P(CPUTest, IndirectPointerWrapsInZeroPage)
+{
+    memory.write(0x0200, 0xB1); // LDA ($FF),Y
+    memory.write(0x0201, 0xFF);
+    memory.write(0x0202, 0x00);
+
+    memory.write(0x00FF, 0x34); // high byte comes from $00, not $0100
+    memory.write(0x0000, 0x12);
+    memory.write(0x0100, 0x56);
+
+    memory.write(0x1234, 0x99);
+    memory.write(0x5634, 0x11);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x99);
+}
+
+TEST_P(CPUTest, LDAIndirectY)
 {
     memory.write(0x0200, 0xB1);
     memory.write(0x0201, 0x70);
@@ -183,7 +220,7 @@ TEST_F(CPUTest, LDAIndirectY)
 
 //* LDX TESTS *//
 
-TEST_F(CPUTest, LDXImmediate)
+TEST_P(CPUTest, LDXImmediate)
 {
     memory.write(0x0200, 0xA2); // load LDX opcode with immediate addressing
     memory.write(0x0201, 0x42); // load literal we want to load into A
@@ -199,7 +236,7 @@ TEST_F(CPUTest, LDXImmediate)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDXZeroPage)
+TEST_P(CPUTest, LDXZeroPage)
 {
     memory.write(0x0200, 0xA6);
     memory.write(0x0201, 0x80);
@@ -217,7 +254,7 @@ TEST_F(CPUTest, LDXZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDXZeroPageY)
+TEST_P(CPUTest, LDXZeroPageY)
 {
     memory.write(0x0200, 0xB6);
     memory.write(0x0201, 0x80);
@@ -236,7 +273,7 @@ TEST_F(CPUTest, LDXZeroPageY)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDXAbsolute)
+TEST_P(CPUTest, LDXAbsolute)
 {
     memory.write(0x0200, 0xAE);
     memory.write(0x0201, 0x10);
@@ -255,7 +292,7 @@ TEST_F(CPUTest, LDXAbsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, LDXAbsoluteY)
+TEST_P(CPUTest, LDXAbsoluteY)
 {
     memory.write(0x0200, 0xBE);
     memory.write(0x0201, 0x20);
@@ -277,7 +314,7 @@ TEST_F(CPUTest, LDXAbsoluteY)
 
 //* LDY TESTS *//
 
-TEST_F(CPUTest, LDYImmediate)
+TEST_P(CPUTest, LDYImmediate)
 {
     memory.write(0x0200, 0xA0); // load LDX opcode with immediate addressing
     memory.write(0x0201, 0x42); // load literal we want to load into A
@@ -293,7 +330,7 @@ TEST_F(CPUTest, LDYImmediate)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDYZeroPage)
+TEST_P(CPUTest, LDYZeroPage)
 {
     memory.write(0x0200, 0xA4);
     memory.write(0x0201, 0x80);
@@ -311,7 +348,7 @@ TEST_F(CPUTest, LDYZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDYZeroPageX)
+TEST_P(CPUTest, LDYZeroPageX)
 {
     memory.write(0x0200, 0xB4);
     memory.write(0x0201, 0x80);
@@ -330,7 +367,7 @@ TEST_F(CPUTest, LDYZeroPageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, LDYAbsolute)
+TEST_P(CPUTest, LDYAbsolute)
 {
     memory.write(0x0200, 0xAC);
     memory.write(0x0201, 0x10);
@@ -349,7 +386,7 @@ TEST_F(CPUTest, LDYAbsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, LDYAbsoluteX)
+TEST_P(CPUTest, LDYAbsoluteX)
 {
     memory.write(0x0200, 0xBC);
     memory.write(0x0201, 0x20);
@@ -371,7 +408,7 @@ TEST_F(CPUTest, LDYAbsoluteX)
 
 //* STA TESTS *//
 
-TEST_F(CPUTest, STAZeroPage)
+TEST_P(CPUTest, STAZeroPage)
 {
     memory.write(0x0200, 0x85);
     memory.write(0x0201, 0x80);
@@ -386,7 +423,7 @@ TEST_F(CPUTest, STAZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STAZeroPageX)
+TEST_P(CPUTest, STAZeroPageX)
 {
     memory.write(0x0200, 0x95);
     memory.write(0x0201, 0x80);
@@ -402,7 +439,7 @@ TEST_F(CPUTest, STAZeroPageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STAAbsoluteX)
+TEST_P(CPUTest, STAAbsoluteX)
 {
     memory.write(0x0200, 0x9D);
     memory.write(0x0201, 0x20);
@@ -419,7 +456,7 @@ TEST_F(CPUTest, STAAbsoluteX)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, STAAbsoluteY)
+TEST_P(CPUTest, STAAbsoluteY)
 {
     memory.write(0x0200, 0x99);
     memory.write(0x0201, 0x20);
@@ -436,7 +473,7 @@ TEST_F(CPUTest, STAAbsoluteY)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, STAIndirectX)
+TEST_P(CPUTest, STAIndirectX)
 {
     memory.write(0x0200, 0x81);
     memory.write(0x0201, 0x70);
@@ -456,7 +493,7 @@ TEST_F(CPUTest, STAIndirectX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STAIndirectY)
+TEST_P(CPUTest, STAIndirectY)
 {
     memory.write(0x0200, 0x91);
     memory.write(0x0201, 0x70);
@@ -476,7 +513,7 @@ TEST_F(CPUTest, STAIndirectY)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STXZeroPage)
+TEST_P(CPUTest, STXZeroPage)
 {
     memory.write(0x0200, 0x86);
     memory.write(0x0201, 0x80);
@@ -491,7 +528,7 @@ TEST_F(CPUTest, STXZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STXZeroPageY)
+TEST_P(CPUTest, STXZeroPageY)
 {
     memory.write(0x0200, 0x96);
     memory.write(0x0201, 0x80);
@@ -507,7 +544,7 @@ TEST_F(CPUTest, STXZeroPageY)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STXAbsolute)
+TEST_P(CPUTest, STXAbsolute)
 {
     memory.write(0x0200, 0x8E);
     memory.write(0x0201, 0x20);
@@ -523,7 +560,7 @@ TEST_F(CPUTest, STXAbsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, STYZeroPage)
+TEST_P(CPUTest, STYZeroPage)
 {
     memory.write(0x0200, 0x84);
     memory.write(0x0201, 0x80);
@@ -538,7 +575,7 @@ TEST_F(CPUTest, STYZeroPage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STYZeroPageX)
+TEST_P(CPUTest, STYZeroPageX)
 {
     memory.write(0x0200, 0x94);
     memory.write(0x0201, 0x80);
@@ -554,7 +591,7 @@ TEST_F(CPUTest, STYZeroPageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, STYAbsolute)
+TEST_P(CPUTest, STYAbsolute)
 {
     memory.write(0x0200, 0x8C);
     memory.write(0x0201, 0x20);
@@ -570,7 +607,7 @@ TEST_F(CPUTest, STYAbsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, TAX) // implied addressing
+TEST_P(CPUTest, TAX) // implied addressing
 {
     memory.write(0x0200, 0xAA);
     memory.write(0x0201, 0x00);
@@ -586,7 +623,7 @@ TEST_F(CPUTest, TAX) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, TAY) // implied addressing
+TEST_P(CPUTest, TAY) // implied addressing
 {
     memory.write(0x0200, 0xA8);
     memory.write(0x0201, 0x00);
@@ -602,7 +639,7 @@ TEST_F(CPUTest, TAY) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, TSX) // implied addressing
+TEST_P(CPUTest, TSX) // implied addressing
 {
     memory.write(0x0200, 0xBA);
     memory.write(0x0201, 0x00);
@@ -618,7 +655,7 @@ TEST_F(CPUTest, TSX) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, TXA) // implied addressing
+TEST_P(CPUTest, TXA) // implied addressing
 {
     memory.write(0x0200, 0x8A);
     memory.write(0x0201, 0x00);
@@ -634,7 +671,7 @@ TEST_F(CPUTest, TXA) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, TXS) // implied addressing
+TEST_P(CPUTest, TXS) // implied addressing
 {
     memory.write(0x0200, 0x9A);
     memory.write(0x0201, 0x00);
@@ -650,7 +687,7 @@ TEST_F(CPUTest, TXS) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, TYA) // implied addressing
+TEST_P(CPUTest, TYA) // implied addressing
 {
     memory.write(0x0200, 0x98);
     memory.write(0x0201, 0x00);
@@ -666,7 +703,7 @@ TEST_F(CPUTest, TYA) // implied addressing
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, PHA)
+TEST_P(CPUTest, PHA)
 {
     memory.write(0x0200, 0x48);
     memory.write(0x0201, 0x00);
@@ -683,7 +720,7 @@ TEST_F(CPUTest, PHA)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, PHP)
+TEST_P(CPUTest, PHP)
 {
     memory.write(0x0200, 0x08);
     memory.write(0x0201, 0x00);
@@ -699,7 +736,7 @@ TEST_F(CPUTest, PHP)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, PLA)
+TEST_P(CPUTest, PLA)
 {
     memory.write(0x0200, 0x68);
     memory.write(0x0201, 0x00);
@@ -717,7 +754,7 @@ TEST_F(CPUTest, PLA)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, PLP)
+TEST_P(CPUTest, PLP)
 {
     memory.write(0x0200, 0x28);
     memory.write(0x0201, 0x00);
@@ -733,7 +770,30 @@ TEST_F(CPUTest, PLP)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, DECzeropage)
+TEST_P(CPUTest, PLPNegativeAndZeroTogether)
+{
+    memory.write(0x0200, 0x28); // PLP: N and Z both set, which no result gives
+    memory.write(0x0201, 0x30); // BMI +1
+    memory.write(0x0202, 0x01);
+    memory.write(0x0203, 0x00);
+    memory.write(0x0204, 0xF0); // BEQ +1
+    memory.write(0x0205, 0x01);
+    memory.write(0x0206, 0x00);
+    memory.write(0x0207, 0x08); // PHP
+    memory.write(0x0208, 0xE8); // INX: N and Z clear
+    memory.write(0x0209, 0x00);
+
+    cpu.setSP(0xFF - 1);
+    memory.write(0x01FF - 1, 0x83);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getPC(), 0x020A);
+    EXPECT_EQ(memory.read(0x01FF), 0x83); // pushed with both still set
+    EXPECT_EQ(cpu.getSR(), CPU::IGNORED | CPU::BREAK | CPU::CARRY);
+}
+
+TEST_P(CPUTest, DECzeropage)
 {
     memory.write(0x0200, 0xC6);
     memory.write(0x0201, 0x42);
@@ -751,7 +811,7 @@ TEST_F(CPUTest, DECzeropage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, DECzeropageX)
+TEST_P(CPUTest, DECzeropageX)
 {
     memory.write(0x0200, 0xD6);
     memory.write(0x0201, 0x40);
@@ -771,7 +831,7 @@ TEST_F(CPUTest, DECzeropageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, DECabsolute)
+TEST_P(CPUTest, DECabsolute)
 {
     //? tests segfault when opcode is D6, should investigate
     memory.write(0x0200, 0xCE);
@@ -791,7 +851,7 @@ TEST_F(CPUTest, DECabsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, DECabsoluteX)
+TEST_P(CPUTest, DECabsoluteX)
 {
     memory.write(0x0200, 0xDE);
     memory.write(0x0201, 0x40);
@@ -812,7 +872,7 @@ TEST_F(CPUTest, DECabsoluteX)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, DEX)
+TEST_P(CPUTest, DEX)
 {
     memory.write(0x0200, 0xCA);
     memory.write(0x0201, 0x00);
@@ -828,7 +888,7 @@ TEST_F(CPUTest, DEX)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, DEY)
+TEST_P(CPUTest, DEY)
 {
     memory.write(0x0200, 0x88);
     memory.write(0x0201, 0x00);
@@ -844,7 +904,7 @@ TEST_F(CPUTest, DEY)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, INCzeropage)
+TEST_P(CPUTest, INCzeropage)
 {
     memory.write(0x0200, 0xE6);
     memory.write(0x0201, 0x42);
@@ -862,7 +922,7 @@ TEST_F(CPUTest, INCzeropage)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, INCzeropageX)
+TEST_P(CPUTest, INCzeropageX)
 {
     memory.write(0x0200, 0xF6);
     memory.write(0x0201, 0x40);
@@ -882,7 +942,7 @@ TEST_F(CPUTest, INCzeropageX)
     EXPECT_EQ(cpu.getPC(), 0x0203);
 }
 
-TEST_F(CPUTest, INCabsolute)
+TEST_P(CPUTest, INCabsolute)
 {
     memory.write(0x0200, 0xEE);
     memory.write(0x0201, 0x40);
@@ -901,7 +961,7 @@ TEST_F(CPUTest, INCabsolute)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, INCabsoluteX)
+TEST_P(CPUTest, INCabsoluteX)
 {
     memory.write(0x0200, 0xFE);
     memory.write(0x0201, 0x40);
@@ -922,7 +982,7 @@ TEST_F(CPUTest, INCabsoluteX)
     EXPECT_EQ(cpu.getPC(), 0x0204);
 }
 
-TEST_F(CPUTest, INX)
+TEST_P(CPUTest, INX)
 {
     memory.write(0x0200, 0xE8);
     memory.write(0x0201, 0x00);
@@ -938,7 +998,7 @@ TEST_F(CPUTest, INX)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, INY)
+TEST_P(CPUTest, INY)
 {
     memory.write(0x0200, 0xC8);
     memory.write(0x0201, 0x00);
@@ -954,7 +1014,7 @@ TEST_F(CPUTest, INY)
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
 
-TEST_F(CPUTest, CLC)
+TEST_P(CPUTest, CLC)
 {
     memory.write(0x0200, 0x18);
     memory.write(0x0201, 0x00);
@@ -969,3 +1029,1992 @@ TEST_F(CPUTest, CLC)
     EXPECT_EQ(cpu.getCycles(), 9);
     EXPECT_EQ(cpu.getPC(), 0x0202);
 }
+
+TEST_P(CPUTest, ILLTrap)
+{
+    memory.write(0x0200, 0x02); // not an implemented opcode
+    memory.write(0x0201, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getCycles(), 0);
+    EXPECT_EQ(cpu.getPC(), 0x0200);
+}
+
+//* BRANCH TESTS *//
+
+TEST_P(CPUTest, BNETakenBackward)
+{
+    memory.write(0x0200, 0xA2); // LDX #$03
+    memory.write(0x0201, 0x03);
+    memory.write(0x0202, 0xCA); // DEX
+    memory.write(0x0203, 0xD0); // BNE -3
+    memory.write(0x0204, 0xFD);
+    memory.write(0x0205, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getX(), 0x00);
+    ASSERT_TRUE(cpu.flag_is_set(CPU::ZERO));
+    EXPECT_EQ(cpu.getCycles(), 23); // 2 + 2 * (2 + 3) + (2 + 2) + 7
+    EXPECT_EQ(cpu.getPC(), 0x0206);
+}
+
+TEST_P(CPUTest, BEQNotTaken)
+{
+    memory.write(0x0200, 0xF0); // BEQ +2
+    memory.write(0x0201, 0x02);
+    memory.write(0x0202, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getCycles(), 9);
+    EXPECT_EQ(cpu.getPC(), 0x0203);
+}
+
+TEST_P(CPUTest, BCCPageCross)
+{
+    memory.write(0x02F0, 0x90); // BCC +$10 lands on the next page
+    memory.write(0x02F1, 0x10);
+    memory.write(0x0302, 0x00);
+
+    cpu.setPC(0x02F0);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getCycles(), 11); // 2 + 1 taken + 1 page cross + 7
+    EXPECT_EQ(cpu.getPC(), 0x0303);
+}
+
+//* ARITHMETIC TESTS *//
+
+TEST_P(CPUTest, ADCClearsCarryAndOverflow)
+{
+    memory.write(0x0200, 0x69); // ADC #$01
+    memory.write(0x0201, 0x01);
+    memory.write(0x0202, 0x00);
+
+    cpu.setA(0x10);
+    cpu.setSR(CPU::CARRY | CPU::OVERFLOW);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x12);
+    ASSERT_FALSE(cpu.flag_is_set(CPU::CARRY));
+    ASSERT_FALSE(cpu.flag_is_set(CPU::OVERFLOW));
+    EXPECT_EQ(cpu.getCycles(), 9);
+}
+
+TEST_P(CPUTest, ADCSignedOverflow)
+{
+    memory.write(0x0200, 0x69); // ADC #$50
+    memory.write(0x0201, 0x50);
+    memory.write(0x0202, 0x00);
+
+    cpu.setA(0x50);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0xA0);
+    ASSERT_TRUE(cpu.flag_is_set(CPU::OVERFLOW));
+    ASSERT_TRUE(cpu.flag_is_set(CPU::NEGATIVE));
+    ASSERT_FALSE(cpu.flag_is_set(CPU::CARRY));
+}
+
+TEST_P(CPUTest, SBCBorrowClearsCarry)
+{
+    memory.write(0x0200, 0xE9); // SBC #$01
+    memory.write(0x0201, 0x01);
+    memory.write(0x0202, 0x00);
+
+    cpu.setA(0x00);
+    cpu.setSR(CPU::CARRY | CPU::OVERFLOW);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0xFF);
+    ASSERT_FALSE(cpu.flag_is_set(CPU::CARRY));
+    ASSERT_FALSE(cpu.flag_is_set(CPU::OVERFLOW));
+    ASSERT_TRUE(cpu.flag_is_set(CPU::NEGATIVE));
+}
+
+TEST_P(CPUTest, ADCDecimal)
+{
+    memory.write(0x0200, 0xF8); // SED
+    memory.write(0x0201, 0x69); // ADC #$46
+    memory.write(0x0202, 0x46);
+    memory.write(0x0203, 0x85); // STA $10
+    memory.write(0x0204, 0x10);
+    memory.write(0x0205, 0x69); // ADC #$12 (plus the carry)
+    memory.write(0x0206, 0x12);
+    memory.write(0x0207, 0x00);
+
+    cpu.setA(0x58);
+    cpu.setSR(CPU::CARRY);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(memory.read(0x0010), 0x05); // 58 + 46 + 1 = 105
+    EXPECT_EQ(cpu.getA(), 0x18);
+    ASSERT_FALSE(cpu.flag_is_set(CPU::CARRY));
+}
+
+TEST_P(CPUTest, SBCDecimal)
+{
+    memory.write(0x0200, 0xF8); // SED
+    memory.write(0x0201, 0x38); // SEC
+    memory.write(0x0202, 0xE9); // SBC #$21
+    memory.write(0x0203, 0x21);
+    memory.write(0x0204, 0x00);
+
+    cpu.setA(0x12);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x91); // 12 - 21 = -9, borrowing 100
+    ASSERT_FALSE(cpu.flag_is_set(CPU::CARRY));
+}
+
+//* SHIFT TESTS *//
+
+TEST_P(CPUTest, ASLAccumulator)
+{
+    memory.write(0x0200, 0x0A);
+    memory.write(0x0201, 0x00);
+
+    cpu.setA(0x81);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x02);
+    ASSERT_TRUE(cpu.flag_is_set(CPU::CARRY));
+    ASSERT_FALSE(cpu.flag_is_set(CPU::NEGATIVE));
+    EXPECT_EQ(cpu.getCycles(), 9);
+    EXPECT_EQ(cpu.getPC(), 0x0202);
+}
+
+TEST_P(CPUTest, LSRzeropage)
+{
+    memory.write(0x0200, 0x46);
+    memory.write(0x0201, 0x42);
+    memory.write(0x0202, 0x00);
+
+    memory.write(0x0042, 0x03);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(memory.read(0x0042), 0x01);
+    ASSERT_TRUE(cpu.flag_is_set(CPU::CARRY));
+    EXPECT_EQ(cpu.getCycles(), 12);
+    EXPECT_EQ(cpu.getPC(), 0x0203);
+}
+
+TEST_P(CPUTest, STAAbsoluteXPageCross)
+{
+    memory.write(0x0200, 0x9D);
+    memory.write(0x0201, 0xF0);
+    memory.write(0x0202, 0x31);
+    memory.write(0x0203, 0x00);
+
+    cpu.setA(0x78);
+    cpu.setX(0x20);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(memory.read(0x3210), 0x78);
+    EXPECT_EQ(cpu.getCycles(), 12); // stores never pay the page-cross cycle
+    EXPECT_EQ(cpu.getPC(), 0x0204);
+}
+
+//* EXECUTION API TESTS *//
+
+TEST_P(CPUTest, StepExecutesOneInstruction)
+{
+    memory.write(0x0200, 0xA9); // LDA #$42
+    memory.write(0x0201, 0x42);
+    memory.write(0x0202, 0xAA); // TAX
+    memory.write(0x0203, 0x00);
+
+    cpu.setPC(0x0200);
+
+    EXPECT_EQ(cpu.step(), 2u);
+    EXPECT_EQ(cpu.getA(), 0x42);
+    EXPECT_EQ(cpu.getX(), 0x00);
+    EXPECT_EQ(cpu.getPC(), 0x0202);
+
+    EXPECT_EQ(cpu.step(), 2u);
+    EXPECT_EQ(cpu.getX(), 0x42);
+    EXPECT_EQ(cpu.step(), 7u);
+    ASSERT_TRUE(cpu.halted());
+    EXPECT_EQ(cpu.step(), 0u);
+}
+
+TEST_P(CPUTest, RunForStopsAtBudget)
+{
+    for (Word address = 0x0200; address < 0x0210; address++) // INX ...
+    {
+        memory.write(address, 0xE8);
+    }
+
+    cpu.setPC(0x0200);
+
+    EXPECT_EQ(cpu.run_for(5), 6u); // three INX, the last one overshoots
+    EXPECT_EQ(cpu.getX(), 0x03);
+    EXPECT_EQ(cpu.run_for(4), 4u);
+    EXPECT_EQ(cpu.getX(), 0x05);
+    EXPECT_EQ(cpu.getCycles(), 10u);
+    ASSERT_FALSE(cpu.halted());
+}
+
+TEST_P(CPUTest, RunUntilAddress)
+{
+    memory.write(0x0200, 0xA2); // LDX #$03
+    memory.write(0x0201, 0x03);
+    memory.write(0x0202, 0xCA); // DEX
+    memory.write(0x0203, 0xD0); // BNE -3
+    memory.write(0x0204, 0xFD);
+    memory.write(0x0205, 0x00);
+
+    cpu.setPC(0x0200);
+
+    EXPECT_EQ(cpu.run_until(0x0205), 16u);
+    EXPECT_EQ(cpu.getPC(), 0x0205);
+    ASSERT_FALSE(cpu.halted());
+    EXPECT_EQ(cpu.run_until(0x0205), 0u); // already there
+}
+
+TEST_P(CPUTest, CyclesDoNotWrap)
+{
+    memory.write(0x0200, 0xA0); // LDY #$00
+    memory.write(0x0201, 0x00);
+    memory.write(0x0202, 0xA2); // LDX #$00
+    memory.write(0x0203, 0x00);
+    memory.write(0x0204, 0xCA); // DEX
+    memory.write(0x0205, 0xD0); // BNE -3
+    memory.write(0x0206, 0xFD);
+    memory.write(0x0207, 0x88); // DEY
+    memory.write(0x0208, 0xD0); // BNE -8
+    memory.write(0x0209, 0xF8);
+    memory.write(0x020A, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getCycles(), 329224u); // 256 * 256 inner iterations
+    EXPECT_EQ(cpu.getPC(), 0x020B);
+}
+
+TEST_P(CPUTest, SelfModifyingCode)
+{
+    memory.write(0x0200, 0xA2); // LDX #$02
+    memory.write(0x0201, 0x02);
+    memory.write(0x0202, 0xA9); // LDA #$05
+    memory.write(0x0203, 0x05);
+    memory.write(0x0204, 0xEE); // INC $0203 (the LDA operand)
+    memory.write(0x0205, 0x03);
+    memory.write(0x0206, 0x02);
+    memory.write(0x0207, 0xCA); // DEX
+    memory.write(0x0208, 0xD0); // BNE -8
+    memory.write(0x0209, 0xF8);
+    memory.write(0x020A, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x06);
+    EXPECT_EQ(memory.read(0x0203), 0x07);
+    EXPECT_EQ(cpu.getCycles(), 34u);
+    EXPECT_EQ(cpu.getPC(), 0x020B);
+}
+
+TEST_P(CPUTest, RomIgnoresWritesAndRunsCode)
+{
+    std::vector<Byte> image(0x100, 0xEA);
+    image[0x00] = 0xAD; // LDA $C080
+    image[0x01] = 0x80;
+    image[0x02] = 0xC0;
+    image[0x03] = 0x8D; // STA $C000, into its own code
+    image[0x04] = 0x00;
+    image[0x05] = 0xC0;
+    image[0x06] = 0xEE; // INC $C080
+    image[0x07] = 0x80;
+    image[0x08] = 0xC0;
+    image[0x09] = 0x00;
+    image[0x80] = 0x42;
+    Rom rom(image);
+    memory.map_rom(0xC0, rom);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        cpu.reset_registers();
+        cpu.setPC(0xC000);
+        cpu.run();
+        EXPECT_EQ(cpu.getA(), 0x42);
+        EXPECT_EQ(cpu.getPC(), 0xC00A);
+    }
+    EXPECT_EQ(memory.read(0xC000), 0xAD);
+    EXPECT_EQ(memory.read(0xC080), 0x42);
+}
+
+TEST_P(CPUTest, ResetRegistersKeepsMemory)
+{
+    memory.write(0x0200, 0xA9); // LDA #$07
+    memory.write(0x0201, 0x07);
+    memory.write(0x0202, 0x85); // STA $10
+    memory.write(0x0203, 0x10);
+    memory.write(0x0204, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+    cpu.reset_registers();
+
+    EXPECT_FALSE(cpu.halted());
+    EXPECT_EQ(cpu.getA(), 0x00);
+    EXPECT_EQ(cpu.getCycles(), 0u);
+    EXPECT_EQ(memory.read(0x0010), 0x07);
+
+    cpu.setPC(0x0200); // the same code runs again
+    cpu.run();
+    EXPECT_EQ(cpu.getA(), 0x07);
+    EXPECT_EQ(cpu.getCycles(), 12u);
+}
+
+TEST_P(CPUTest, ResetThenReloadRunsNewCode)
+{
+    memory.write(0x0200, 0xA9); // LDA #$01
+    memory.write(0x0201, 0x01);
+    memory.write(0x0202, 0x00);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    cpu.reset();
+    memory.write(0x0200, 0xA2); // LDX #$02, over the old code
+    memory.write(0x0201, 0x02);
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x00);
+    EXPECT_EQ(cpu.getX(), 0x02);
+    EXPECT_EQ(memory.read(0x0202), 0x00);
+}
+
+//* BLOCK CACHE TESTS *//
+
+TEST(BlockCacheTest, StatsAndInvalidation)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+
+    memory.write(0x0200, 0xA2); // LDX #$03
+    memory.write(0x0201, 0x03);
+    memory.write(0x0202, 0xCA); // DEX
+    memory.write(0x0203, 0xD0); // BNE -3
+    memory.write(0x0204, 0xFD);
+    memory.write(0x0205, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    cache_stats stats = cpu.getCacheStats();
+    EXPECT_EQ(stats.misses, 3u); // $0200, $0202, $0205
+    EXPECT_EQ(stats.hits, 1u);   // second trip round the loop
+    EXPECT_EQ(stats.invalidations, 0u);
+
+    memory.write(0x0300, 0xFF); // not a code page
+    EXPECT_EQ(cpu.getCacheStats().invalidations, 0u);
+
+    memory.write(0x0202, 0xCA); // any write to page $02 drops its blocks
+    EXPECT_EQ(cpu.getCacheStats().invalidations, 3u);
+
+    cpu.setEngine(CPU::SWITCH);
+    EXPECT_EQ(cpu.getCacheStats().misses, 0u);
+}
+
+//* FUSION TESTS *//
+
+TEST(FusionTest, LoopsRunAsSuperinstructions)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+
+    const Byte program[] = {
+        0xA2, 0x10, // LDX #$10
+        0xCA,       // DEX
+        0xD0, 0xFD, // BNE -3
+        0xA9, 0x05, // LDA #$05
+        0x8D, 0x00, 0x03, // STA $0300
+        0x00,
+    };
+    memory.load(0x0200, program, sizeof(program));
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getX(), 0x00);
+    EXPECT_EQ(memory.read(0x0300), 0x05);
+    EXPECT_EQ(cpu.getCycles(), 2u + 16 * 2 + 15 * 3 + 2 + 2 + 4 + 7);
+
+    std::vector<std::vector<Byte>> sequences = CPU::fusions();
+    std::size_t dex_bne = std::find(sequences.begin(), sequences.end(), std::vector<Byte>{0xCA, 0xD0}) - sequences.begin();
+    std::size_t lda_sta = std::find(sequences.begin(), sequences.end(), std::vector<Byte>{0xA9, 0x8D}) - sequences.begin();
+    ASSERT_LT(dex_bne, sequences.size());
+    ASSERT_LT(lda_sta, sequences.size());
+
+    fusion_stats stats = cpu.getFusionStats();
+    EXPECT_EQ(stats.formed, 3u); // the loop body is decoded again as its own block
+    EXPECT_EQ(stats.executed, 17u);
+    EXPECT_EQ(stats.split, 0u);
+    EXPECT_EQ(stats.by_sequence[dex_bne], 16u);
+    EXPECT_EQ(stats.by_sequence[lda_sta], 1u);
+}
+
+TEST(FusionTest, StepsAndStopsInsideASuperinstruction)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+
+    const Byte program[] = {
+        0xA5, 0x10,       // LDA $10
+        0x18,             // CLC
+        0x69, 0x01,       // ADC #$01
+        0x8D, 0x00, 0x03, // STA $0300
+        0x00,
+    };
+    memory.load(0x0200, program, sizeof(program));
+    memory.write(0x0010, 0x41);
+
+    cpu.setPC(0x0200);
+    EXPECT_EQ(cpu.step(), 3u); // LDA alone, though the block fused it
+    EXPECT_EQ(cpu.getPC(), 0x0202);
+    cpu.run_until(0x0203); // stops between CLC and ADC
+    EXPECT_EQ(cpu.getPC(), 0x0203);
+    EXPECT_EQ(cpu.getA(), 0x41);
+    cpu.run();
+    EXPECT_EQ(memory.read(0x0300), 0x42);
+    EXPECT_GE(cpu.getFusionStats().split, 1u);
+
+    cpu.reset_registers(); // from the top, fused this time
+    cpu.setPC(0x0200);
+    cpu.run();
+    EXPECT_EQ(cpu.getCycles(), 3u + 2 + 2 + 4 + 7);
+    EXPECT_EQ(cpu.getFusionStats().executed, 1u);
+}
+
+TEST(FusionTest, SetFusionsPicksTheSequences)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+
+    EXPECT_FALSE(cpu.setFusions({{0xCA, 0xD0}, {0xEA, 0xEA}})); // NOP NOP has no handler
+    const Byte program[] = {
+        0xA2, 0x03, // LDX #$03
+        0xCA,       // DEX
+        0xD0, 0xFD, // BNE -3
+        0xA9, 0x00, // LDA #$00
+        0x85, 0x10, // STA $10
+        0x00,
+    };
+    memory.load(0x0200, program, sizeof(program));
+    cpu.setPC(0x0200);
+    cpu.run();
+    EXPECT_EQ(cpu.getFusionStats().executed, 3u); // DEX; BNE only
+
+    EXPECT_TRUE(cpu.setFusions({}));
+    cpu.reset_registers();
+    cpu.setPC(0x0200);
+    cpu.run();
+    EXPECT_EQ(cpu.getFusionStats().executed, 3u);
+    EXPECT_EQ(cpu.getX(), 0x00);
+}
+
+TEST(FusionTest, StoreIntoTheSequenceIsNotFused)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+
+    // code in the zero page: INC $15 rewrites the BNE offset it is fused with
+    const Byte program[] = {
+        0xA2, 0x02, // $10: LDX #$02
+        0xE6, 0x15, // $12: INC $15, turning BNE +0 into BNE +1
+        0xD0, 0x00, // $14: BNE
+        0xE8,       // $16: INX, skipped once the offset is 1
+        0x00,       // $17: BRK
+    };
+    memory.load(0x0010, program, sizeof(program));
+    cpu.setPC(0x0010);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getX(), 0x02);
+    EXPECT_EQ(memory.read(0x0015), 0x01);
+    EXPECT_EQ(cpu.getFusionStats().formed, 0u);
+}
+
+//* DEAD FLAG TESTS *//
+
+TEST(DeadFlagTest, LeanBlockEndsWithExactFlags)
+{
+    const Byte program[] = {
+        0xA9, 0x80, // LDA #$80: N/Z live, the store may end the block
+        0x85, 0x10, // STA $10
+        0xA9, 0x00, // LDA #$00: N/Z overwritten by LDX
+        0xA2, 0x80, // LDX #$80: N/Z overwritten by CMP
+        0x38,       // SEC: C overwritten by CMP
+        0xC9, 0x01, // CMP #$01: N/Z overwritten by TAY
+        0xA8,       // TAY
+        0x00,
+    };
+
+    Memory memory, reference_memory;
+    CPU cpu(&memory), reference(&reference_memory);
+    cpu.setEngine(CPU::CACHED);
+    reference.setEngine(CPU::SWITCH);
+    for (Memory *m : {&memory, &reference_memory})
+    {
+        m->load(0x0200, program, sizeof(program));
+    }
+    cpu.setPC(0x0200);
+    reference.setPC(0x0200);
+    cpu.run();
+    reference.run();
+
+    EXPECT_EQ(cpu.getSR(), reference.getSR());
+    EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+    EXPECT_TRUE(cpu.getSR() & CPU::ZERO);
+    EXPECT_FALSE(cpu.getSR() & CPU::CARRY);
+
+    elision_stats stats = cpu.getElisionStats();
+    EXPECT_EQ(stats.nz, 3u);
+    EXPECT_EQ(stats.cv, 1u);
+    EXPECT_EQ(stats.lean, 1u);
+    EXPECT_EQ(stats.exact, 0u);
+}
+
+TEST(DeadFlagTest, StoppingInsideABlockKeepsEveryFlag)
+{
+    const Byte program[] = {
+        0xA9, 0x00, // LDA #$00
+        0x38,       // SEC
+        0xA2, 0x80, // LDX #$80
+        0xC9, 0x01, // CMP #$01
+        0xA8,       // TAY
+        0x00,
+    };
+
+    Memory memory, reference_memory;
+    CPU cpu(&memory), reference(&reference_memory);
+    cpu.setEngine(CPU::CACHED);
+    reference.setEngine(CPU::SWITCH);
+    for (Memory *m : {&memory, &reference_memory})
+    {
+        m->load(0x0200, program, sizeof(program));
+    }
+    cpu.setPC(0x0200);
+    reference.setPC(0x0200);
+    while (!reference.halted())
+    {
+        EXPECT_EQ(cpu.step(), reference.step());
+        EXPECT_EQ(cpu.getSR(), reference.getSR()) << "at " << std::hex << reference.getPC();
+    }
+    EXPECT_EQ(cpu.getElisionStats().lean, 0u);
+    EXPECT_GE(cpu.getElisionStats().exact, 1u);
+
+    cpu.reset_registers();
+    cpu.setPC(0x0200);
+    cpu.run_until(0x0205); // between LDX and CMP
+    EXPECT_TRUE(cpu.getSR() & CPU::NEGATIVE);
+    EXPECT_TRUE(cpu.getSR() & CPU::CARRY);
+
+    cpu.setFlagElision(false);
+    cpu.reset_registers();
+    cpu.setPC(0x0200);
+    cpu.run();
+    EXPECT_EQ(cpu.getElisionStats().lean, 0u);
+    EXPECT_EQ(cpu.getSR(), reference.getSR());
+}
+
+//* IDLE LOOP TESTS *//
+
+TEST(IdleTest, PollingLoopSkipsToTheEndOfTheBudget)
+{
+    const Byte program[] = {
+        0xA5, 0x10, // LDA $10
+        0xF0, 0xFC, // BEQ -4
+        0xA2, 0x01, // LDX #$01
+        0x00,
+    };
+
+    Memory memory, reference_memory;
+    CPU cpu(&memory), reference(&reference_memory);
+    cpu.setEngine(CPU::CACHED);
+    reference.setEngine(CPU::CACHED);
+    reference.setIdleSkipping(false);
+    for (Memory *m : {&memory, &reference_memory})
+    {
+        m->load(0x0200, program, sizeof(program));
+    }
+    cpu.setPC(0x0200);
+    reference.setPC(0x0200);
+
+    EXPECT_EQ(cpu.run_for(100001), reference.run_for(100001));
+    EXPECT_EQ(cpu.getPC(), reference.getPC());
+    EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+    idle_stats stats = cpu.getIdleStats();
+    EXPECT_EQ(stats.loops, 1u);
+    EXPECT_GT(stats.skipped, 99000u);
+    EXPECT_EQ(stats.skipped % 6, 0u); // whole iterations of LDA zp; BEQ taken
+    EXPECT_EQ(reference.getIdleStats().loops, 0u);
+
+    // the host changes $10 between runs, and the loop notices
+    memory.write(0x0010, 0x01);
+    reference_memory.write(0x0010, 0x01);
+    cpu.run();
+    reference.run();
+    EXPECT_EQ(cpu.getX(), 0x01);
+    EXPECT_EQ(cpu.getCycles(), reference.getCycles());
+}
+
+TEST(IdleTest, OnlySteadyDevicesAndRepeatingLoopsAreSkipped)
+{
+    struct Status : Device
+    {
+        bool is_steady = false;
+        Byte read(Word) override { return 0x00; }
+        void write(Word, Byte) override {}
+        bool steady() const override { return is_steady; }
+    } status;
+
+    const Byte program[] = {
+        0xAD, 0x00, 0xD0, // LDA $D000
+        0x10, 0xFB,       // BPL -5
+        0x00,
+    };
+
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+    memory.map_device(0xD0, &status);
+    memory.load(0x0200, program, sizeof(program));
+    cpu.setPC(0x0200);
+    cpu.run_for(10000);
+    EXPECT_EQ(cpu.getIdleStats().loops, 0u); // the device might change at any read
+
+    status.is_steady = true;
+    cpu.run_for(10000);
+    EXPECT_EQ(cpu.getIdleStats().loops, 1u);
+
+    // a counting loop never repeats its registers
+    const Byte countdown[] = {
+        0xCA,       // DEX
+        0xD0, 0xFD, // BNE -3
+        0x00,
+    };
+    memory.load(0x0300, countdown, sizeof(countdown));
+    cpu.setPC(0x0300);
+    cpu.setX(0x00);
+    cpu.run();
+    EXPECT_EQ(cpu.getX(), 0x00);
+    EXPECT_EQ(cpu.getIdleStats().loops, 1u);
+}
+
+TEST(FusionTest, MatchesSwitchOnFusableCode)
+{
+    std::vector<std::vector<Byte>> sequences = CPU::fusions();
+    for (unsigned seed = 1; seed <= 32; seed++)
+    {
+        Memory reference_memory, fused_memory;
+        CPU reference(&reference_memory), fused(&fused_memory);
+        reference.setEngine(CPU::SWITCH);
+        fused.setEngine(CPU::CACHED);
+
+        // straight runs of fusable sequences with random operands; stores
+        // go to $0300-$03FF and branches stay short so the code stays put
+        std::mt19937 rng(seed);
+        std::vector<Byte> code;
+        while (code.size() < 0xC0)
+        {
+            for (Byte opcode : sequences[rng() % sequences.size()])
+            {
+                code.push_back(opcode);
+                if (opcode == 0xD0 || opcode == 0xF0)
+                {
+                    code.push_back(rng() % 4);
+                }
+                else if (opcode == 0x8D)
+                {
+                    code.push_back(rng());
+                    code.push_back(0x03);
+                }
+                else if (opcode == 0xAD)
+                {
+                    code.push_back(rng());
+                    code.push_back(rng() % 4);
+                }
+                else if (opcode != 0xCA && opcode != 0x88 && opcode != 0xE8 && opcode != 0xC8 &&
+                         opcode != 0x18 && opcode != 0x38)
+                {
+                    code.push_back(rng() | 0x80); // zero page above the code
+                }
+            }
+        }
+        code.push_back(0x00);
+        reference_memory.load(0x0400, code.data(), code.size());
+        fused_memory.load(0x0400, code.data(), code.size());
+
+        reference.setPC(0x0400);
+        fused.setPC(0x0400);
+        for (int slice = 0; slice < 40; slice++)
+        {
+            ASSERT_EQ(reference.run_for(7), fused.run_for(7)) << "seed " << seed;
+        }
+        ASSERT_EQ(reference.getA(), fused.getA()) << "seed " << seed;
+        ASSERT_EQ(reference.getX(), fused.getX()) << "seed " << seed;
+        ASSERT_EQ(reference.getY(), fused.getY()) << "seed " << seed;
+        ASSERT_EQ(reference.getSR(), fused.getSR()) << "seed " << seed;
+        ASSERT_EQ(reference.getPC(), fused.getPC()) << "seed " << seed;
+        ASSERT_EQ(reference.getCycles(), fused.getCycles()) << "seed " << seed;
+        ASSERT_EQ(reference_memory.compare(0x0000, fused_memory.view(0x0000, 0x100).data, 0x100), 0);
+        ASSERT_EQ(reference_memory.compare(0x0300, fused_memory.view(0x0300, 0x100).data, 0x100), 0);
+        ASSERT_GT(fused.getFusionStats().executed, 0u) << "seed " << seed;
+    }
+}
+
+//* JIT TESTS *//
+
+TEST(JitTest, TranslatesAndChainsHotBlocks)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::JIT);
+    cpu.setJitThreshold(2);
+
+    memory.write(0x0200, 0xA2); // LDX #$10
+    memory.write(0x0201, 0x10);
+    memory.write(0x0202, 0xCA); // DEX
+    memory.write(0x0203, 0xD0); // BNE -3
+    memory.write(0x0204, 0xFD);
+    memory.write(0x0205, 0x00);
+
+    cpu.setPC(0x0200);
+    EXPECT_EQ(cpu.run_for(42), 42u); // LDX, then eight trips round the loop
+    EXPECT_EQ(cpu.getX(), 0x08);
+#if CPU_HAS_JIT
+    jit_stats stats = cpu.getJitStats();
+    EXPECT_EQ(stats.translations, 1u); // only the loop body is hot
+    EXPECT_EQ(stats.native_entries, 1u);
+    EXPECT_EQ(stats.links, 1u); // the loop jumps straight back into itself
+    EXPECT_EQ(stats.flushes, 0u);
+#endif
+
+    memory.write(0x0202, 0xCA); // invalidation discards native code on the next run
+    cpu.run();
+
+    EXPECT_EQ(cpu.getX(), 0x00);
+    EXPECT_EQ(cpu.getCycles(), 2u + 16 * 5 - 1 + 7);
+    EXPECT_EQ(cpu.getPC(), 0x0206);
+#if CPU_HAS_JIT
+    EXPECT_EQ(cpu.getJitStats().flushes, 1u);
+    EXPECT_EQ(cpu.getJitStats().translations, 2u); // the loop got hot again
+#endif
+}
+
+TEST(JitTest, MatchesInterpreterOnRandomPrograms)
+{
+    std::vector<Byte> opcodes;
+#define TEST_OPCODE(code, mnemonic, addressing, cycles) \
+    if (code != 0x00)                                   \
+    {                                                   \
+        opcodes.push_back(code);                        \
+    }
+    CPU_OPCODES(TEST_OPCODE)
+#undef TEST_OPCODE
+
+    for (unsigned seed = 1; seed <= 64; seed++)
+    {
+        Memory reference_memory, jit_memory;
+        CPU reference(&reference_memory), jit(&jit_memory);
+        jit.setEngine(CPU::JIT);
+        jit.setJitThreshold(0);
+
+        std::mt19937 rng(seed);
+        for (Word address = 0x0000; address < 0x0100; address++) // zero page pointers
+        {
+            Byte b = rng();
+            reference_memory.write(address, b);
+            jit_memory.write(address, b);
+        }
+        for (Word address = 0x0200; address < 0x0280; address += 3)
+        {
+            Byte code[3] = {opcodes[rng() % opcodes.size()], Byte(rng()), Byte(rng() & 0x03)};
+            for (int i = 0; i < 3; i++)
+            {
+                reference_memory.write(address + i, code[i]);
+                jit_memory.write(address + i, code[i]);
+            }
+        }
+
+        reference.setPC(0x0200);
+        jit.setPC(0x0200);
+        for (int slice = 0; slice < 8; slice++)
+        {
+            ASSERT_EQ(reference.run_for(250), jit.run_for(250)) << "seed " << seed;
+        }
+
+        ASSERT_EQ(reference.getA(), jit.getA()) << "seed " << seed;
+        ASSERT_EQ(reference.getX(), jit.getX()) << "seed " << seed;
+        ASSERT_EQ(reference.getY(), jit.getY()) << "seed " << seed;
+        ASSERT_EQ(reference.getSP(), jit.getSP()) << "seed " << seed;
+        ASSERT_EQ(reference.getSR(), jit.getSR()) << "seed " << seed;
+        ASSERT_EQ(reference.getPC(), jit.getPC()) << "seed " << seed;
+        ASSERT_EQ(reference.getCycles(), jit.getCycles()) << "seed " << seed;
+        ASSERT_EQ(reference.halted(), jit.halted()) << "seed " << seed;
+        for (std::uint32_t address = 0; address <= 0xFFFF; address++)
+        {
+            ASSERT_EQ(reference_memory.read(address), jit_memory.read(address))
+                << "seed " << seed << " address " << address;
+        }
+    }
+}
+
+//* RECOMPILER TESTS *//
+
+bool sum_aot(CPU &cpu, std::uint64_t cycle_limit, std::int32_t stop_at); // tests/sum_aot.cpp
+
+// tests/sum.bin: A = sum of $0301..$0310, with running totals in $0401..$0410
+static const Byte sum_image[] = {
+    0xA2, 0x10,       // LDX #$10
+    0xA9, 0x00,       // LDA #$00
+    0x18,             // CLC
+    0x7D, 0x00, 0x03, // ADC $0300,X
+    0x9D, 0x00, 0x04, // STA $0400,X
+    0xCA,             // DEX
+    0xD0, 0xF6,       // BNE -10
+    0x00              // BRK
+};
+
+static void load_sum(Memory &memory)
+{
+    for (Word i = 0; i < sizeof(sum_image); i++)
+    {
+        memory.write(0x0200 + i, sum_image[i]);
+    }
+    for (Word i = 1; i <= 0x10; i++)
+    {
+        memory.write(0x0300 + i, i * 3);
+    }
+}
+
+TEST(RecompilerTest, TracesReachableCode)
+{
+    Memory memory;
+    load_sum(memory);
+
+    Recompiler recompiler(memory);
+    recompiler.trace(0x0200);
+
+    EXPECT_EQ(recompiler.instructions(), 8u);
+    EXPECT_TRUE(recompiler.reachable(0x0204)); // branch target
+    EXPECT_FALSE(recompiler.reachable(0x0203)); // operand byte
+    EXPECT_FALSE(recompiler.reachable(0x020F)); // after BRK
+
+    std::string source = recompiler.emit("sum_aot");
+    EXPECT_NE(source.find("bool sum_aot(CPU &cpu"), std::string::npos);
+    EXPECT_NE(source.find("goto L0204;"), std::string::npos);
+}
+
+TEST(RecompilerTest, MatchesInterpreter)
+{
+    Memory reference_memory, aot_memory;
+    CPU reference(&reference_memory), aot(&aot_memory);
+    load_sum(reference_memory);
+    load_sum(aot_memory);
+    aot.setRecompiled(sum_aot);
+
+    reference.setPC(0x0200);
+    aot.setPC(0x0200);
+    for (int slice = 0; slice < 50; slice++) // stop and resume mid-program
+    {
+        ASSERT_EQ(reference.run_for(7), aot.run_for(7));
+        ASSERT_EQ(reference.getPC(), aot.getPC());
+    }
+
+    ASSERT_TRUE(aot.halted());
+    EXPECT_EQ(aot.getA(), reference.getA());
+    EXPECT_EQ(aot.getSR(), reference.getSR());
+    EXPECT_EQ(aot.getCycles(), reference.getCycles());
+    for (Word address = 0x0400; address <= 0x0410; address++)
+    {
+        EXPECT_EQ(aot_memory.read(address), reference_memory.read(address));
+    }
+}
+
+TEST(RecompilerTest, InterpretsCodeChangedSinceTheTrace)
+{
+    Memory reference_memory, aot_memory;
+    CPU reference(&reference_memory), aot(&aot_memory);
+    load_sum(reference_memory);
+    load_sum(aot_memory);
+    aot.setRecompiled(sum_aot);
+
+    for (Memory *memory : {&reference_memory, &aot_memory})
+    {
+        memory->write(0x0201, 0x04); // LDX #$04: sum four values, not sixteen
+        memory->write(0x0204, 0x38); // SEC instead of CLC
+    }
+    reference.setPC(0x0200);
+    aot.setPC(0x0200);
+    reference.run();
+    aot.run();
+
+    EXPECT_EQ(aot.getA(), reference.getA());
+    EXPECT_EQ(aot.getSR(), reference.getSR());
+    EXPECT_EQ(aot.getCycles(), reference.getCycles());
+    EXPECT_EQ(aot_memory.read(0x0405), 0x00); // past the new count, never written
+    for (Word address = 0x0401; address <= 0x0404; address++)
+    {
+        EXPECT_EQ(aot_memory.read(address), reference_memory.read(address));
+    }
+}
+
+TEST(RecompilerTest, InterpretsUnknownCode)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    load_sum(memory);
+    cpu.setRecompiled(sum_aot);
+
+    memory.write(0x0300, 0xA0); // LDY #$07, never traced
+    memory.write(0x0301, 0x07);
+    memory.write(0x0302, 0xF0); // BEQ +0, PC lands on $0304
+    memory.write(0x0303, 0x00);
+    memory.write(0x0304, 0x00);
+
+    cpu.setPC(0x0300);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getY(), 0x07);
+    EXPECT_EQ(cpu.getPC(), 0x0305);
+    EXPECT_EQ(cpu.getCycles(), 11u);
+}
+
+//* LOCKSTEP TESTS *//
+
+TEST(LockstepTest, LanesDivergeAndRejoin)
+{
+    Memory memory;
+    CPU cpu(&memory);
+
+    memory.write(0x0200, 0xA5); // LDA $10
+    memory.write(0x0201, 0x10);
+    memory.write(0x0202, 0xF0); // BEQ +1
+    memory.write(0x0203, 0x01);
+    memory.write(0x0204, 0xE8); // INX
+    memory.write(0x0205, 0xE8); // INX
+    memory.write(0x0206, 0xC8); // INY, both paths meet here
+    memory.write(0x0207, 0x00);
+    cpu.setPC(0x0200);
+
+    Lockstep batch(10); // one full vector and a partial one
+    for (std::size_t lane = 0; lane < batch.size(); lane++)
+    {
+        memory.write(0x0010, lane % 2); // even lanes skip the first INX
+        batch.load(lane, cpu, memory);
+    }
+    batch.run();
+
+    for (std::size_t lane = 0; lane < batch.size(); lane++)
+    {
+        bool taken = lane % 2 == 0;
+        EXPECT_TRUE(batch.halted(lane));
+        EXPECT_EQ(batch.getX(lane), taken ? 1 : 2);
+        EXPECT_EQ(batch.getY(lane), 1);
+        EXPECT_EQ(batch.getPC(lane), 0x0208);
+        EXPECT_EQ(batch.getCycles(lane), taken ? 3u + 3 + 2 + 2 + 7 : 3u + 2 + 2 + 2 + 2 + 7);
+    }
+
+    lockstep_stats stats = batch.getStats();
+    EXPECT_EQ(stats.lane_instructions, 5u * 5 + 5u * 6);
+    EXPECT_EQ(stats.steps, 2u * 6); // the extra INX runs once per vector, masked
+}
+
+TEST(LockstepTest, StoreIsTheInverseOfLoad)
+{
+    struct Latch : Device
+    {
+        int reads = 0;
+        int writes = 0;
+        Byte read(Word) override
+        {
+            reads++;
+            return 0xFF;
+        }
+        void write(Word, Byte) override { writes++; }
+    } latch;
+
+    Memory memory;
+    CPU cpu(&memory);
+    const Byte program[] = {
+        0xA9, 0x07,       // LDA #$07
+        0x8D, 0x00, 0x30, // STA $3000
+        0x00,
+    };
+    memory.load(0x0200, program, sizeof(program));
+    memory.map_device(0xD0, &latch);
+    cpu.setPC(0x0200);
+
+    Lockstep batch(1);
+    batch.load(0, cpu, memory);
+    batch.run();
+    batch.store(0, cpu, memory);
+
+    EXPECT_EQ(cpu.getA(), 0x07);
+    EXPECT_EQ(cpu.getCycles(), batch.getCycles(0));
+    EXPECT_EQ(cpu.getCycles(), 2u + 4 + 7);
+    EXPECT_TRUE(cpu.halted());
+    EXPECT_EQ(memory.read(0x3000), 0x07);
+    EXPECT_EQ(memory.dirty_pages(), 2u); // the code page and $30, not all 256
+    EXPECT_EQ(latch.reads, 0);
+    EXPECT_EQ(latch.writes, 0);
+
+    memory.map_device(0xD0, nullptr); // the RAM underneath was left alone
+    EXPECT_EQ(memory.read(0xD000), 0x00);
+    EXPECT_EQ(memory.read(0xD0FF), 0x00);
+}
+
+TEST(LockstepTest, MatchesInterpreterOnRandomPrograms)
+{
+    std::vector<Byte> opcodes;
+#define TEST_OPCODE(code, mnemonic, addressing, cycles) \
+    if (code != 0x00)                                   \
+    {                                                   \
+        opcodes.push_back(code);                        \
+    }
+    CPU_OPCODES(TEST_OPCODE)
+#undef TEST_OPCODE
+
+    const std::size_t lanes = 20;
+    for (unsigned seed = 1; seed <= 16; seed++)
+    {
+        // one program, but every lane starts from different data and registers
+        std::mt19937 rng(seed);
+        std::vector<Byte> program;
+        for (int i = 0; i < 0x60; i++)
+        {
+            program.insert(program.end(), {opcodes[rng() % opcodes.size()], Byte(rng()), Byte(rng() & 0x03)});
+        }
+
+        Lockstep batch(lanes);
+        std::vector<Memory> memories(lanes);
+        std::vector<CPU> cpus;
+        for (std::size_t lane = 0; lane < lanes; lane++)
+        {
+            cpus.emplace_back(&memories[lane]);
+            for (Word address = 0x0000; address < 0x0100; address++)
+            {
+                memories[lane].write(address, rng());
+            }
+            for (std::size_t i = 0; i < program.size(); i++)
+            {
+                memories[lane].write(0x0200 + i, program[i]);
+            }
+            cpus[lane].setA(rng());
+            cpus[lane].setX(rng());
+            cpus[lane].setY(rng());
+            cpus[lane].setSR(rng() & 0xCF);
+            cpus[lane].setPC(0x0200);
+            batch.load(lane, cpus[lane], memories[lane]);
+        }
+
+        for (int slice = 0; slice < 4; slice++)
+        {
+            batch.run_for(300);
+            for (std::size_t lane = 0; lane < lanes; lane++)
+            {
+                cpus[lane].run_for(300);
+            }
+        }
+
+        for (std::size_t lane = 0; lane < lanes; lane++)
+        {
+            ASSERT_EQ(batch.getA(lane), cpus[lane].getA()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getX(lane), cpus[lane].getX()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getY(lane), cpus[lane].getY()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getSP(lane), cpus[lane].getSP()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getSR(lane), cpus[lane].getSR()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getPC(lane), cpus[lane].getPC()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.getCycles(lane), cpus[lane].getCycles()) << "seed " << seed << " lane " << lane;
+            ASSERT_EQ(batch.halted(lane), cpus[lane].halted()) << "seed " << seed << " lane " << lane;
+            for (std::uint32_t address = 0; address <= 0xFFFF; address++)
+            {
+                ASSERT_EQ(batch.read(lane, address), memories[lane].read(address))
+                    << "seed " << seed << " lane " << lane << " address " << address;
+            }
+        }
+    }
+}
+
+//* FARM TESTS *//
+
+TEST(FarmTest, RunsEveryJobOnce)
+{
+    // $0200: LDX $10; DEX; BNE -3; STX $11; BRK, counting down from $10
+    auto image = std::make_shared<const std::vector<Byte>>(std::vector<Byte>{
+        0xA6, 0x10, 0xCA, 0xD0, 0xFD, 0x86, 0x11, 0x00});
+
+    const std::size_t jobs = 300;
+    std::vector<std::uint64_t> cycles(jobs, 0);
+    std::vector<int> runs(jobs, 0);
+
+    std::uint64_t expected_cycles = 0;
+    {
+        Farm farm(4, CPU::CACHED);
+        ASSERT_EQ(farm.size(), 4u);
+        for (std::size_t i = 0; i < jobs; i++)
+        {
+            // each job gets its own count in the zero page
+            auto patched = std::make_shared<std::vector<Byte>>(0x0208, 0x00);
+            std::copy(image->begin(), image->end(), patched->begin() + 0x0200);
+            (*patched)[0x10] = i % 50 + 1;
+            expected_cycles += 3 + (i % 50 + 1) * 5 - 1 + 3 + 7;
+
+            farm.submit({patched, 0x0000, 0x0200, 100000, [&cycles, &runs, i](CPU &cpu, Memory &memory) {
+                             EXPECT_TRUE(cpu.halted());
+                             EXPECT_EQ(memory.read(0x0011), 0x00);
+                             cycles[i] = cpu.getCycles();
+                             runs[i]++;
+                         }});
+        }
+        farm.wait();
+
+        std::vector<worker_stats> stats = farm.getStats();
+        std::uint64_t total_jobs = 0, total_cycles = 0;
+        for (const worker_stats &worker : stats)
+        {
+            total_jobs += worker.jobs;
+            total_cycles += worker.cycles;
+            EXPECT_LE(worker.max_queue_ns, worker.queue_ns);
+        }
+        EXPECT_EQ(total_jobs, jobs);
+        EXPECT_EQ(total_cycles, expected_cycles);
+    }
+
+    for (std::size_t i = 0; i < jobs; i++)
+    {
+        EXPECT_EQ(runs[i], 1);
+        EXPECT_EQ(cycles[i], 3u + (i % 50 + 1) * 5 - 1 + 3 + 7);
+    }
+}
+
+TEST(FarmTest, BudgetStopsLongJobs)
+{
+    auto image = std::make_shared<const std::vector<Byte>>(std::vector<Byte>{0xE8, 0xD0, 0xFD}); // INX; BNE -3
+
+    Byte x = 0;
+    bool halted = true;
+    {
+        Farm farm(2);
+        farm.submit({image, 0x0300, 0x0300, 40, [&](CPU &cpu, Memory &) {
+                         x = cpu.getX();
+                         halted = cpu.halted();
+                     }});
+    } // the destructor drains the queue
+
+    EXPECT_EQ(x, 8);
+    EXPECT_FALSE(halted);
+}
+
+//* MEMORY TESTS *//
+
+TEST(MemoryTest, ForkSharesPagesUntilWritten)
+{
+    Memory base;
+    base.write(0x0200, 0xA9);
+    base.write(0x1234, 0x56);
+    EXPECT_EQ(base.private_pages(), 2u);
+
+    Memory child(base);
+    EXPECT_EQ(base.private_pages(), 0u);
+    EXPECT_EQ(child.private_pages(), 0u);
+    EXPECT_EQ(child.read(0x1234), 0x56);
+
+    child.write(0x1234, 0x78); // copies page $12 only
+    EXPECT_EQ(child.private_pages(), 1u);
+    EXPECT_EQ(child.read(0x1234), 0x78);
+    EXPECT_EQ(child.read(0x1235), 0x00);
+    EXPECT_EQ(base.read(0x1234), 0x56);
+    EXPECT_EQ(base.private_pages(), 1u); // page $12 is now base's alone
+
+    Memory grandchild(child);
+    grandchild.reset(); // back to the zero page for the shared ones, the others untouched
+    EXPECT_EQ(grandchild.read(0x0200), 0x00);
+    EXPECT_EQ(child.read(0x0200), 0xA9);
+    EXPECT_EQ(child.read(0x1234), 0x78);
+
+    child = base;
+    EXPECT_EQ(child.read(0x1234), 0x56);
+}
+
+TEST(MemoryTest, ForkedMachinesRunIndependently)
+{
+    Memory base;
+    base.write(0x0200, 0xEE); // INC $0300
+    base.write(0x0201, 0x00);
+    base.write(0x0202, 0x03);
+    base.write(0x0203, 0x00);
+
+    for (int i = 0; i < 3; i++)
+    {
+        Memory memory(base);
+        CPU cpu(&memory);
+        cpu.setEngine(CPU::CACHED);
+        cpu.setPC(0x0200);
+        cpu.run();
+        EXPECT_EQ(memory.read(0x0300), 0x01);
+        EXPECT_EQ(memory.private_pages(), 1u);
+    }
+    EXPECT_EQ(base.read(0x0300), 0x00);
+}
+
+TEST(MemoryTest, DevicePagesTakeTheSlowPath)
+{
+    struct Latch : Device
+    {
+        Byte value = 0x42;
+        int reads = 0, writes = 0;
+        Word last = 0;
+
+        Byte read(Word address) override
+        {
+            reads++;
+            last = address;
+            return value;
+        }
+
+        void write(Word address, Byte data) override
+        {
+            writes++;
+            last = address;
+            value = data;
+        }
+    } latch;
+
+    Memory memory;
+    CPU cpu(&memory);
+    memory.map_device(0xD0, &latch);
+
+    memory.write(0x0200, 0xAD); // LDA $D012
+    memory.write(0x0201, 0x12);
+    memory.write(0x0202, 0xD0);
+    memory.write(0x0203, 0xE8); // INX
+    memory.write(0x0204, 0x8E); // STX $D0FF
+    memory.write(0x0205, 0xFF);
+    memory.write(0x0206, 0xD0);
+    memory.write(0x0207, 0x00);
+
+    cpu.setPC(0x0200);
+    cpu.run();
+
+    EXPECT_EQ(cpu.getA(), 0x42);
+    EXPECT_EQ(latch.reads, 1);
+    EXPECT_EQ(latch.writes, 1);
+    EXPECT_EQ(latch.last, 0xD0FF);
+    EXPECT_EQ(latch.value, 0x01);
+
+    memory.map_device(0xD0, nullptr); // RAM underneath was never touched
+    EXPECT_EQ(memory.read(0xD0FF), 0x00);
+}
+
+TEST(MemoryTest, ReadWordIsLittleEndianAcrossPages)
+{
+    struct Constant : Device
+    {
+        Byte read(Word) override { return 0xAB; }
+        void write(Word, Byte) override {}
+    } constant;
+
+    Memory memory;
+    memory.write(0x0410, 0x34);
+    memory.write(0x0411, 0x12);
+    memory.write(0x04FF, 0xCD);
+    memory.write(0x0500, 0x01);
+    memory.write(0xFFFF, 0x22);
+    memory.write(0x0000, 0x11);
+    memory.map_device(0xD0, &constant);
+    memory.write(0xCFFF, 0x01);
+
+    EXPECT_EQ(memory.read_word(0x0410), 0x1234);
+    EXPECT_EQ(memory.read_word(0x04FF), 0x01CD);
+    EXPECT_EQ(memory.read_word(0xFFFF), 0x1122); // wraps around the address space
+    EXPECT_EQ(memory.read_word(0xD010), 0xABAB);
+    EXPECT_EQ(memory.read_word(0xCFFF), 0xAB01);
+}
+
+TEST(MemoryTest, ResetClearsOnlyDirtyPages)
+{
+    Memory memory;
+    EXPECT_EQ(memory.dirty_pages(), 0u);
+
+    memory.write(0x0010, 0x01);
+    memory.write(0x0011, 0x02);
+    memory.write(0x8000, 0x03);
+    memory.write(0xFFFF, 0x04);
+    EXPECT_EQ(memory.dirty_pages(), 3u);
+
+    Memory fork(memory); // dirty pages stay dirty in both
+    EXPECT_EQ(fork.dirty_pages(), 3u);
+
+    memory.reset();
+    EXPECT_EQ(memory.dirty_pages(), 0u);
+    for (std::uint32_t address = 0; address <= 0xFFFF; address++)
+    {
+        ASSERT_EQ(memory.read(address), 0x00) << "address " << address;
+    }
+    EXPECT_EQ(fork.read(0x8000), 0x03);
+
+    fork.reset();
+    EXPECT_EQ(fork.read(0xFFFF), 0x00);
+    EXPECT_EQ(fork.private_pages(), 3u); // clean pages are still shared with memory
+}
+
+TEST(MemoryTest, PoolRecyclesPages)
+{
+    MemoryPool pool(false);
+    {
+        Memory memory(&pool);
+        memory.write(0x1234, 0x56);
+        Memory fork(memory); // allocates from the same pool
+        fork.write(0x1234, 0x78);
+
+        EXPECT_EQ(memory.read(0x1234), 0x56);
+        EXPECT_EQ(fork.read(0x1234), 0x78);
+        EXPECT_EQ(pool.getStats().pages_used, 2u);
+    }
+    pool_stats released = pool.getStats();
+    EXPECT_EQ(released.pages_used, 0u);
+    EXPECT_EQ(released.pages_free, 2u);
+
+    Memory again(&pool);
+    again.write(0x1200, 0x01); // a recycled page, copied from the zero page
+    EXPECT_EQ(again.read(0x1234), 0x00);
+    EXPECT_EQ(pool.getStats().arenas, released.arenas);
+    EXPECT_EQ(pool.getStats().pages_free, 1u);
+}
+
+TEST(MemoryTest, PagesAreAllocatedOnFirstWrite)
+{
+    MemoryPool pool(false);
+    std::vector<Memory> machines(1000, Memory(&pool));
+    for (Memory &memory : machines)
+    {
+        EXPECT_EQ(memory.private_pages(), 0u);
+        EXPECT_EQ(memory.read(0x8000), 0x00);
+        memory.write(0x0010, 0x01); // zero page, stack and program
+        memory.write(0x01FF, 0x02);
+        memory.write(0x0200, 0x03);
+    }
+
+    EXPECT_EQ(pool.getStats().pages_used, 3000u);
+    EXPECT_EQ(pool.getStats().arenas, 1u); // ~800KB of pages for 1000 machines
+    EXPECT_EQ(machines[999].read(0x01FF), 0x02);
+    EXPECT_EQ(machines[999].private_pages(), 3u);
+
+    machines[0].reset(); // pages stay allocated for the next run
+    EXPECT_EQ(machines[0].read(0x0200), 0x00);
+    EXPECT_EQ(pool.getStats().pages_used, 3000u);
+}
+
+TEST(MemoryTest, RomPagesAreSharedAndReadOnly)
+{
+    std::vector<Memory> machines(4);
+    {
+        std::vector<Byte> image(0x180); // a page and a half
+        for (std::size_t i = 0; i < image.size(); i++)
+        {
+            image[i] = Byte(i + 1);
+        }
+        Rom rom(image);
+        EXPECT_EQ(rom.size(), 2u);
+        for (Memory &memory : machines)
+        {
+            memory.map_rom(0xF0, rom);
+        }
+    } // the machines keep the pages alive
+
+    for (Memory &memory : machines)
+    {
+        memory.write(0xF010, 0x00);
+        EXPECT_EQ(memory.read(0xF010), 0x11);
+        EXPECT_EQ(memory.read(0xF17F), 0x80);
+        EXPECT_EQ(memory.read(0xF180), 0x00); // padding
+        EXPECT_EQ(memory.private_pages(), 0u);
+    }
+
+    Memory fork(machines[0]);
+    fork.write(0xF000, 0x99);
+    machines[0].write(0xF000, 0x99);
+    EXPECT_EQ(fork.read(0xF000), 0x01);
+    EXPECT_EQ(machines[0].read(0xF000), 0x01);
+
+    machines[1].write(0x0200, 0x05);
+    machines[1].reset(); // RAM cleared, ROM stays
+    EXPECT_EQ(machines[1].read(0x0200), 0x00);
+    EXPECT_EQ(machines[1].read(0xF000), 0x01);
+}
+
+TEST(MemoryTest, RangesCrossPagesAndDevices)
+{
+    struct Counter : Device
+    {
+        Byte next = 0;
+        std::vector<Byte> written;
+        Byte read(Word) override { return next++; }
+        void write(Word, Byte data) override { written.push_back(data); }
+    } counter;
+
+    Memory memory;
+    memory.map_device(0x30, &counter);
+    std::vector<Byte> data(0x300);
+    for (std::size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = Byte(i * 7);
+    }
+
+    memory.load(0x2F80, data.data(), data.size()); // RAM, device, RAM
+    EXPECT_EQ(counter.written.size(), 0x100u);
+    EXPECT_EQ(counter.written[0], data[0x80]);
+    EXPECT_EQ(memory.read(0x2F80), data[0x00]);
+    EXPECT_EQ(memory.read(0x3100), data[0x180]);
+    EXPECT_EQ(memory.read(0x327F), data[0x2FF]);
+    EXPECT_EQ(memory.compare(0x3100, &data[0x180], 0x180), 0);
+
+    std::vector<Byte> out(0x300);
+    memory.dump(0x2F80, out.data(), out.size());
+    EXPECT_EQ(out[0x7F], data[0x7F]);
+    EXPECT_EQ(out[0x80], 0x00); // the device's first read
+    EXPECT_EQ(out[0x17F], 0xFF);
+    EXPECT_EQ(out[0x180], data[0x180]);
+
+    data[0x200]++;
+    EXPECT_LT(memory.compare(0x3100, &data[0x180], 0x180), 0);
+
+    memory.fill(0x3180, 0xEE, 0x80);
+    EXPECT_EQ(memory.read(0x317F), data[0x1FF]);
+    EXPECT_EQ(memory.read(0x3180), 0xEE);
+    EXPECT_EQ(memory.read(0x3200), data[0x280]);
+
+    memory.fill(0x0000, 0x01, 0x10010); // stops at $FFFF
+    EXPECT_EQ(memory.read(0xFFFF), 0x01);
+    EXPECT_EQ(memory.read(0x0000), 0x01);
+    EXPECT_EQ(memory.dirty_pages(), 255u); // every page but the device
+
+    memory.fill(0x0000, 0x00, 0x10000); // cleared pages go back to the zero page
+    EXPECT_EQ(memory.private_pages(), 0u);
+    EXPECT_EQ(memory.dirty_pages(), 0u);
+}
+
+TEST(MemoryTest, SpansStayWithinAPage)
+{
+    Memory memory;
+    memory.write(0x12FE, 0x34);
+    Memory fork(memory);
+
+    ConstSpan view = memory.view(0x12F0, 0x40);
+    EXPECT_EQ(view.size, 0x10u); // to the end of page $12
+    EXPECT_EQ(view.data[0x0E], 0x34);
+
+    Span edit = fork.edit(0x12FE, 2);
+    ASSERT_EQ(edit.size, 2u);
+    for (Byte &b : edit)
+    {
+        b = 0x99;
+    }
+    EXPECT_EQ(fork.read(0x12FE), 0x99);
+    EXPECT_EQ(fork.read(0x12FF), 0x99);
+    EXPECT_EQ(memory.read(0x12FE), 0x34); // the fork got its own copy first
+
+    struct Nothing : Device
+    {
+        Byte read(Word) override { return 0; }
+        void write(Word, Byte) override {}
+    } nothing;
+    memory.map_device(0xD0, &nothing);
+    EXPECT_TRUE(memory.view(0xD000, 1).empty());
+    EXPECT_TRUE(memory.edit(0xD000, 1).empty());
+
+    Rom rom(std::vector<Byte>(0x100, 0xEA));
+    memory.map_rom(0xF0, rom);
+    EXPECT_EQ(memory.view(0xF000, 1).data[0], 0xEA);
+    EXPECT_TRUE(memory.edit(0xF000, 1).empty());
+}
+
+//* BUS TESTS *//
+
+TEST(BasicCPUTest, FlatMemoryMatchesCPU)
+{
+    std::vector<Byte> opcodes;
+#define TEST_OPCODE(code, mnemonic, addressing, cycles) \
+    if (code != 0x00)                                   \
+    {                                                   \
+        opcodes.push_back(code);                        \
+    }
+    CPU_OPCODES(TEST_OPCODE)
+#undef TEST_OPCODE
+
+    for (unsigned seed = 1; seed <= 32; seed++)
+    {
+        Memory reference_memory;
+        auto flat_memory = std::make_unique<FlatMemory>();
+        CPU reference(&reference_memory);
+        BasicCPU<FlatMemory> flat(flat_memory.get());
+
+        std::mt19937 rng(seed);
+        for (Word address = 0x0000; address < 0x0100; address++) // zero page pointers
+        {
+            Byte b = rng();
+            reference_memory.write(address, b);
+            flat_memory->write(address, b);
+        }
+        for (Word address = 0x0200; address < 0x0280; address += 3)
+        {
+            Byte code[3] = {opcodes[rng() % opcodes.size()], Byte(rng()), Byte(rng() & 0x03)};
+            for (int i = 0; i < 3; i++)
+            {
+                reference_memory.write(address + i, code[i]);
+                flat_memory->write(address + i, code[i]);
+            }
+        }
+
+        reference.setPC(0x0200);
+        flat.setPC(0x0200);
+        for (int slice = 0; slice < 8; slice++)
+        {
+            ASSERT_EQ(reference.run_for(250), flat.run_for(250)) << "seed " << seed;
+        }
+
+        ASSERT_EQ(reference.getA(), flat.getA()) << "seed " << seed;
+        ASSERT_EQ(reference.getX(), flat.getX()) << "seed " << seed;
+        ASSERT_EQ(reference.getY(), flat.getY()) << "seed " << seed;
+        ASSERT_EQ(reference.getSP(), flat.getSP()) << "seed " << seed;
+        ASSERT_EQ(reference.getSR(), flat.getSR()) << "seed " << seed;
+        ASSERT_EQ(reference.getPC(), flat.getPC()) << "seed " << seed;
+        ASSERT_EQ(reference.getCycles(), flat.getCycles()) << "seed " << seed;
+        ASSERT_EQ(reference.halted(), flat.halted()) << "seed " << seed;
+        for (std::uint32_t address = 0; address <= 0xFFFF; address++)
+        {
+            ASSERT_EQ(reference_memory.read(address), flat_memory->read(address))
+                << "seed " << seed << " address " << address;
+        }
+    }
+}
+
+TEST(BasicCPUTest, DecimalModeMatchesNmos)
+{
+    // every A, operand and carry against the NMOS decimal sequences,
+    // worked one step at a time instead of a digit table at a time
+    auto flat = std::make_unique<FlatMemory>();
+    BasicCPU<FlatMemory> cpu(flat.get());
+    const Byte flags = CPU::NEGATIVE | CPU::OVERFLOW | CPU::ZERO | CPU::CARRY;
+
+    for (int subtract = 0; subtract < 2; subtract++)
+    {
+        flat->write(0x0200, subtract ? 0xE9 : 0x69);
+        flat->write(0x0202, 0x00);
+        for (int a = 0; a < 256; a++)
+        {
+            for (int b = 0; b < 256; b++)
+            {
+                for (int c = 0; c < 2; c++)
+                {
+                    int result;
+                    Byte sr = 0;
+                    if (!subtract)
+                    {
+                        int low = (a & 0x0F) + (b & 0x0F) + c;
+                        if (low >= 0x0A)
+                        {
+                            low = ((low + 0x06) & 0x0F) + 0x10;
+                        }
+                        int sum = (a & 0xF0) + (b & 0xF0) + low;
+                        int sign = std::int8_t(a & 0xF0) + std::int8_t(b & 0xF0) + low;
+                        sr |= (sum & 0x80) ? CPU::NEGATIVE : 0;
+                        sr |= (sign < -128 || sign > 127) ? CPU::OVERFLOW : 0;
+                        sr |= ((a + b + c) & 0xFF) == 0 ? CPU::ZERO : 0;
+                        if (sum >= 0xA0)
+                        {
+                            sum += 0x60;
+                        }
+                        sr |= sum >= 0x100 ? CPU::CARRY : 0;
+                        result = sum & 0xFF;
+                    }
+                    else
+                    {
+                        int low = (a & 0x0F) - (b & 0x0F) + c - 1;
+                        if (low < 0)
+                        {
+                            low = ((low - 0x06) & 0x0F) - 0x10;
+                        }
+                        int difference = (a & 0xF0) - (b & 0xF0) + low;
+                        if (difference < 0)
+                        {
+                            difference -= 0x60;
+                        }
+                        result = difference & 0xFF;
+                        int binary = a - b - (1 - c);
+                        sr |= (binary & 0x80) ? CPU::NEGATIVE : 0;
+                        sr |= ((a ^ b) & (a ^ binary) & 0x80) ? CPU::OVERFLOW : 0;
+                        sr |= (binary & 0xFF) == 0 ? CPU::ZERO : 0;
+                        sr |= binary >= 0 ? CPU::CARRY : 0;
+                    }
+
+                    cpu.reset_registers();
+                    flat->write(0x0201, b);
+                    cpu.setA(a);
+                    cpu.setSR(CPU::DECIMAL | c);
+                    cpu.setPC(0x0200);
+                    cpu.run();
+                    ASSERT_EQ(cpu.getA(), result) << (subtract ? "SBC " : "ADC ") << a << ", " << b << ", " << c;
+                    ASSERT_EQ(cpu.getSR() & flags, sr) << (subtract ? "SBC " : "ADC ") << a << ", " << b << ", " << c;
+                }
+            }
+        }
+    }
+}
+
+//* SAVE STATE TESTS *//
+
+TEST(SaveStateTest, RestoresRegistersAndMemory)
+{
+    std::string path = ::testing::TempDir() + "save_state_test.bin";
+
+    Memory memory;
+    CPU cpu(&memory);
+    memory.write(0x0200, 0xA2); // LDX #$05
+    memory.write(0x0201, 0x05);
+    memory.write(0x0202, 0xCA); // DEX
+    memory.write(0x0203, 0x8E); // STX $3000
+    memory.write(0x0204, 0x00);
+    memory.write(0x0205, 0x30);
+    memory.write(0x0206, 0xD0); // BNE -6
+    memory.write(0x0207, 0xFA);
+    memory.write(0x0208, 0x00);
+    cpu.setPC(0x0200);
+    cpu.setSR(0x20);
+    cpu.run_for(20); // stop mid-loop
+
+    ASSERT_TRUE(SaveState::save(path, cpu, memory));
+
+    SaveState state;
+    ASSERT_TRUE(state.open(path));
+    EXPECT_EQ(state.stored_pages(), 2u); // the code page and $30
+
+    Memory copy(memory); // a fork finishes the run for reference
+    CPU reference(&copy);
+    reference.setPC(cpu.getPC());
+    reference.setX(cpu.getX());
+    reference.setSR(cpu.getSR());
+    reference.run();
+
+    std::vector<Memory> memories(8);
+    for (Memory &restored_memory : memories)
+    {
+        restored_memory.write(0x4000, 0xFF); // gone after the restore
+        CPU restored(&restored_memory);
+        restored.setEngine(CPU::CACHED);
+        state.restore(restored, restored_memory);
+
+        EXPECT_EQ(restored.getPC(), cpu.getPC());
+        EXPECT_EQ(restored.getX(), cpu.getX());
+        EXPECT_EQ(restored.getSR(), cpu.getSR());
+        EXPECT_EQ(restored.getCycles(), cpu.getCycles());
+        EXPECT_EQ(restored_memory.read(0x4000), 0x00);
+        EXPECT_EQ(restored_memory.private_pages(), 0u); // still in the mapping
+
+        restored.run();
+        EXPECT_EQ(restored.getCycles() - cpu.getCycles(), reference.getCycles());
+        EXPECT_EQ(restored.getX(), 0x00);
+        EXPECT_EQ(restored_memory.read(0x3000), 0x00);
+        EXPECT_EQ(restored_memory.private_pages(), 1u); // only $30 was written
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(SaveStateTest, RestoredMachineOutlivesTheState)
+{
+    std::string path = ::testing::TempDir() + "save_state_outlive.bin";
+
+    Memory memory;
+    CPU cpu(&memory);
+    memory.write(0x0300, 0x11);
+    memory.write(0x0301, 0x22);
+    ASSERT_TRUE(SaveState::save(path, cpu, memory));
+
+    Memory restored_memory;
+    CPU restored(&restored_memory);
+    {
+        SaveState state;
+        ASSERT_TRUE(state.open(path));
+        state.restore(restored, restored_memory);
+    }
+    std::remove(path.c_str());
+
+    EXPECT_EQ(restored_memory.read(0x0300), 0x11); // the mapping is still there
+    EXPECT_EQ(restored_memory.private_pages(), 0u);
+    restored_memory.write(0x0301, 0x01); // copied, never written in place
+    EXPECT_EQ(restored_memory.read(0x0300), 0x11);
+    EXPECT_EQ(restored_memory.read(0x0301), 0x01);
+    EXPECT_EQ(restored_memory.private_pages(), 1u);
+
+    Memory fork(restored_memory);
+    fork.write(0x0302, 0x33);
+    EXPECT_EQ(restored_memory.read(0x0302), 0x00);
+
+    // reset() with a page still in the mapping, held by the machine alone
+    Memory other;
+    CPU other_cpu(&other);
+    {
+        SaveState state;
+        ASSERT_TRUE(SaveState::save(path, cpu, memory));
+        ASSERT_TRUE(state.open(path));
+        state.restore(other_cpu, other);
+    }
+    std::remove(path.c_str());
+    other_cpu.reset(); // page $03 still points into the mapping
+    EXPECT_EQ(other.read(0x0300), 0x00);
+    EXPECT_EQ(other.read(0x0301), 0x00);
+    EXPECT_EQ(other.dirty_pages(), 0u);
+}
+
+TEST(SaveStateTest, RejectsOtherFiles)
+{
+    std::string path = ::testing::TempDir() + "save_state_bad.bin";
+    SaveState state;
+    EXPECT_FALSE(state.open(path + ".missing"));
+
+    Memory memory;
+    CPU cpu(&memory);
+    memory.write(0x0000, 0x01);
+    ASSERT_TRUE(SaveState::save(path, cpu, memory));
+
+    FILE *file = std::fopen(path.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    std::fseek(file, 8, SEEK_SET);
+    std::fputc(SaveState::VERSION + 1, file);
+    std::fclose(file);
+    EXPECT_FALSE(state.open(path));
+
+    ASSERT_TRUE(SaveState::save(path, cpu, memory));
+    ASSERT_EQ(truncate(path.c_str(), SaveState::HEADER_SIZE + 100), 0);
+    EXPECT_FALSE(state.open(path));
+    std::remove(path.c_str());
+}
+
+//* REWIND TESTS *//
+
+namespace
+{
+    void load_counter(Memory &memory)
+    {
+        const Byte program[] = {
+            0xA2, 0x00,       // LDX #$00
+            0xFE, 0x00, 0x30, // INC $3000,X
+            0xE8,             // INX
+            0xD0, 0xFA,       // BNE -6
+            0xEE, 0x00, 0x40, // INC $4000
+            0xD0, 0xF3,       // BNE -13
+            0x00,
+        };
+        for (std::size_t i = 0; i < sizeof(program); i++)
+        {
+            memory.write(0x0200 + i, program[i]);
+        }
+    }
+}
+
+TEST(RewindTest, RestoresAnyHeldPoint)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    load_counter(memory);
+    cpu.setPC(0x0200);
+
+    Rewind history(cpu, memory, 8, 1000);
+    history.run_for(20000);
+    ASSERT_EQ(history.size(), 8u);
+    EXPECT_EQ(history.getStats().captures, 20u);
+    EXPECT_LT(history.getStats().bytes, 8u * 1024); // deltas, not 64KB frames
+
+    for (std::size_t index : {7u, 5u, 2u, 0u})
+    {
+        std::uint64_t target = history.cycles_at(index);
+        history.rewind(index);
+        EXPECT_EQ(history.size(), index + 1);
+
+        Memory reference_memory;
+        CPU reference(&reference_memory);
+        load_counter(reference_memory);
+        reference.setPC(0x0200);
+        reference.run_for(target);
+
+        ASSERT_EQ(cpu.getCycles(), reference.getCycles());
+        EXPECT_EQ(cpu.getPC(), reference.getPC());
+        EXPECT_EQ(cpu.getX(), reference.getX());
+        EXPECT_EQ(cpu.getSR(), reference.getSR());
+        for (std::uint32_t address = 0; address <= 0xFFFF; address++)
+        {
+            ASSERT_EQ(memory.read(address), reference_memory.read(address)) << "address " << address;
+        }
+    }
+}
+
+TEST(RewindTest, RunsTheSameFutureAgain)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    cpu.setEngine(CPU::CACHED);
+    load_counter(memory);
+    cpu.setPC(0x0200);
+
+    Rewind history(cpu, memory, 4, 500);
+    history.run_for(3000);
+    Byte counter = memory.read(0x3010);
+    Word pc = cpu.getPC();
+    std::uint64_t cycles = cpu.getCycles();
+
+    EXPECT_FALSE(history.rewind_to(1200)); // dropped: only 1500-3000 are held
+    ASSERT_TRUE(history.rewind_to(2200));
+    EXPECT_LE(cpu.getCycles(), 2200u);
+    EXPECT_GE(cpu.getCycles(), 2000u);
+    cpu.run_for(cycles - cpu.getCycles());
+
+    EXPECT_EQ(cpu.getCycles(), cycles);
+    EXPECT_EQ(cpu.getPC(), pc);
+    EXPECT_EQ(memory.read(0x3010), counter);
+}
+
+TEST(RewindTest, CatchesUpWithACPURunDirectly)
+{
+    Memory memory;
+    CPU cpu(&memory);
+    const Byte program[] = {
+        0x18,       // CLC
+        0x90, 0xFE, // BCC -2
+    };
+    memory.load(0x0200, program, sizeof(program));
+    cpu.setPC(0x0200);
+
+    Rewind history(cpu, memory, 8, 100);
+    std::size_t held = history.size();
+    cpu.run_for(1000); // past ten capture points, behind the history's back
+    std::uint64_t ran = history.run_for(50);
+    EXPECT_GE(ran, 50u);
+    EXPECT_LT(ran, 53u);
+    EXPECT_EQ(history.size(), held + 1); // one capture where run_for() picked up
+    EXPECT_GE(history.cycles_at(history.size() - 1), 1000u);
+}
+
+//* LOADER TESTS *//
+
+namespace
+{
+    std::string write_file(const std::string &name, const std::string &contents)
+    {
+        std::string path = ::testing::TempDir() + name;
+        FILE *file = std::fopen(path.c_str(), "wb");
+        std::fwrite(contents.data(), 1, contents.size(), file);
+        std::fclose(file);
+        return path;
+    }
+}
+
+TEST(LoaderTest, DetectsFormatsByExtension)
+{
+    EXPECT_EQ(Image::detect("game.PRG"), Image::PRG);
+    EXPECT_EQ(Image::detect("rom.hex"), Image::HEX);
+    EXPECT_EQ(Image::detect("rom.ihx"), Image::HEX);
+    EXPECT_EQ(Image::detect("kernal.bin"), Image::RAW);
+}
+
+TEST(LoaderTest, BootsRawImageFromResetVector)
+{
+    std::string rom(0x2000, '\xEA');
+    rom[0x0000] = '\xA2'; // $E000: LDX #$07
+    rom[0x0001] = '\x07';
+    rom[0x0002] = '\x00';
+    rom[0x1FFC] = '\x00'; // reset vector: $E000
+    rom[0x1FFD] = '\xE0';
+    std::string path = write_file("loader_test.bin", rom);
+
+    Image image;
+    ASSERT_TRUE(image.open(path, Image::RAW, 0xE000));
+    EXPECT_EQ(image.origin(), 0xE000);
+    EXPECT_EQ(image.size(), 0x2000u);
+
+    Memory memory;
+    CPU cpu(&memory);
+    image.boot(cpu, memory);
+    EXPECT_EQ(cpu.getPC(), 0xE000);
+    cpu.run();
+    EXPECT_EQ(cpu.getX(), 0x07);
+
+    // the same file as ROM pages over the mapping
+    std::unique_ptr<Rom> pages = image.rom();
+    ASSERT_NE(pages, nullptr);
+    Memory rom_memory;
+    rom_memory.map_rom(image.origin() >> 8, *pages);
+    rom_memory.write(0xE001, 0x99);
+    EXPECT_EQ(rom_memory.read(0xE001), 0x07);
+    EXPECT_EQ(rom_memory.read_word(0xFFFC), 0xE000);
+    EXPECT_EQ(rom_memory.private_pages(), 0u);
+
+    EXPECT_FALSE(image.open(path, Image::RAW, 0xF000)); // runs past $FFFF
+    std::remove(path.c_str());
+}
+
+TEST(LoaderTest, LoadsPrgAtItsHeaderAddress)
+{
+    std::string path = write_file("loader_test.prg", std::string("\x01\x08\xA9\x05\x00", 5));
+    Image image;
+    ASSERT_TRUE(image.open(path, Image::detect(path)));
+    EXPECT_EQ(image.origin(), 0x0801);
+    EXPECT_EQ(image.rom(), nullptr); // not on a page boundary
+
+    Memory memory;
+    image.load(memory);
+    EXPECT_EQ(memory.read(0x0801), 0xA9);
+    EXPECT_EQ(memory.read(0x0802), 0x05);
+    EXPECT_EQ(memory.read(0x0800), 0x00);
+    std::remove(path.c_str());
+}
+
+TEST(LoaderTest, ParsesIntelHex)
+{
+    std::string path = write_file("loader_test.hex",
+                                  ":020000040000FA\n"
+                                  ":02020000A94211\r\n"  // $0200: LDA #$42
+                                  ":0302020085100064\n" // $0202: STA $10; BRK
+                                  ":02FFFC00000201\n"   // reset vector: $0200
+                                  ":00000001FF\n");
+
+    Image image;
+    ASSERT_TRUE(image.open(path, Image::HEX));
+    EXPECT_EQ(image.size(), 7u); // the two code records merge into one segment
+
+    Memory memory;
+    CPU cpu(&memory);
+    image.boot(cpu, memory);
+    EXPECT_EQ(cpu.getPC(), 0x0200);
+    cpu.run();
+    EXPECT_EQ(memory.read(0x0010), 0x42);
+
+    std::string bad = write_file("loader_bad.hex", ":02020000A94212\n"); // checksum off by one
+    EXPECT_FALSE(image.open(bad, Image::HEX));
+    std::remove(path.c_str());
+    std::remove(bad.c_str());
+}
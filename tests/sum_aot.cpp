@@ -0,0 +1,65 @@
+// Generated by 6502-aot: 8 instructions.
+// Valid only for the image it was traced from; do not edit.
+
+#include "aot.h"
+
+bool sum_aot(CPU &cpu, std::uint64_t cycle_limit, std::int32_t stop_at)
+{
+    using A = CPU::aot;
+
+    switch (A::pc(cpu))
+    {
+    case 0x0200: goto L0200;
+    case 0x0202: goto L0202;
+    case 0x0204: goto L0204;
+    case 0x0205: goto L0205;
+    case 0x0208: goto L0208;
+    case 0x020B: goto L020B;
+    case 0x020C: goto L020C;
+    case 0x020E: goto L020E;
+    default: return false;
+    }
+
+L0200: // LDX
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0xA2>(cpu, 0x0200, 0x0010)) return false;
+    A::step<0xA2>(cpu, 0x0010, 0x0202);
+
+L0202: // LDA
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0xA9>(cpu, 0x0202, 0x0000)) return false;
+    A::step<0xA9>(cpu, 0x0000, 0x0204);
+
+L0204: // CLC
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0x18>(cpu, 0x0204, 0x0000)) return false;
+    A::step<0x18>(cpu, 0x0000, 0x0205);
+
+L0205: // ADC
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0x7D>(cpu, 0x0205, 0x0300)) return false;
+    A::step<0x7D>(cpu, 0x0300, 0x0208);
+
+L0208: // STA
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0x9D>(cpu, 0x0208, 0x0400)) return false;
+    A::step<0x9D>(cpu, 0x0400, 0x020B);
+
+L020B: // DEX
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0xCA>(cpu, 0x020B, 0x0000)) return false;
+    A::step<0xCA>(cpu, 0x0000, 0x020C);
+
+L020C: // BNE
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0xD0>(cpu, 0x020C, 0x00F6)) return false;
+    A::step<0xD0>(cpu, 0x00F6, 0x020E);
+    if (A::pc(cpu) == 0x0204)
+        goto L0204;
+
+L020E: // BRK
+    if (A::stop(cpu, cycle_limit, stop_at)) return true;
+    if (!A::traced<0x00>(cpu, 0x020E, 0x0000)) return false;
+    A::step<0x00>(cpu, 0x0000, 0x020F);
+    return true;
+}